@@ -6,6 +6,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "exception.hh"
 #include "sync_print.hh"
@@ -45,6 +46,26 @@ void run_cmd( Cluster & c, string out_dir, string cmd, uint64_t read_ahead )
     auto dur = chrono::duration_cast<chrono::milliseconds>( end - start ).count();
     print( "\ncmd-chunk", dur );
 
+  } else if ( cmd.compare( 0, 4, "cdf-" ) == 0 ) {
+    auto points = stoul( cmd.substr( 4 ) );
+
+    auto start = chrono::high_resolution_clock::now();
+    uint64_t size = c.Size();
+    vector<uint64_t> positions;
+    for ( uint64_t i = 0; i < points; i++ ) {
+      positions.push_back( size * i / points );
+    }
+    auto recs = c.ReadMany( positions );
+    auto end = chrono::high_resolution_clock::now();
+    auto dur = chrono::duration_cast<chrono::milliseconds>( end - start ).count();
+
+    File out = query_file( out_dir, 0, "cdf" );
+    for ( auto & r : recs ) {
+      out.write_all( (const char *) r.key(), Rec::KEY_LEN );
+      out.write_all( (const char *) r.val(), Rec::VAL_LEN );
+    }
+    print( "\ncmd-cdf", dur, points );
+
   } else if ( cmd.find_first_of( "range-" ) == 0 ) {
     size_t i = cmd.find_last_of( '-' );
     auto siz = atol( cmd.substr( i + 1 ).c_str() );
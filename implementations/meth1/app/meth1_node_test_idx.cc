@@ -0,0 +1,87 @@
+/**
+ * Do a local machine sort using the method1::Node INDEX_SORT API (ReadIdx +
+ * Gather) + write out to disk.
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "file.hh"
+#include "timestamp.hh"
+#include "record.hh"
+#include "node.hh"
+
+using namespace std;
+using namespace meth1;
+
+void run( vector<string> files, string fout, double block )
+{
+  for ( auto & f : files ) {
+    cout << f << endl;
+  }
+  File out( fout, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+  auto t0 = time_now();
+
+  // start node
+  Node node{files, "0", true};
+  node.Initialize();
+  auto t1 = time_now();
+
+  // size
+  auto siz = node.Size();
+  auto t2 = time_now();
+
+  if ( siz <= 0 ) {
+    cout << "Empty file!" << endl;
+    return;
+  }
+
+  // read + gather + write
+  size_t block_size = block * siz;
+  unique_ptr<char[]> buf( new char[block_size * Rec::SIZE] );
+  for ( size_t i = 0; i < siz; i += block_size ) {
+    auto recs = node.ReadIdx( i, block_size );
+    node.Gather( recs, buf.get() );
+    out.write_all( buf.get(), recs.size() * Rec::SIZE );
+  }
+  out.fsync();
+  auto t3 = time_now();
+
+  // stats
+  auto tinit = time_diff<ms>( t1, t0 );
+  auto tsize = time_diff<ms>( t2, t1 );
+  auto tread = time_diff<ms>( t3, t2 );
+  auto ttota = time_diff<ms>( t3, t0 );
+
+  cout << "-----------------------" << endl;
+  cout << "Records " << siz << endl;
+  cout << "-----------------------" << endl;
+  cout << "Start took " << tinit << "ms" << endl;
+  cout << "Size  took " << tsize << "ms" << endl;
+  cout << "Read  took " << tread << "ms (read + sort + gather + write)" << endl;
+  cout << "Total took " << ttota << "ms" << endl;
+}
+
+void check_usage( const int argc, const char * const argv[] )
+{
+  if ( argc < 4 ) {
+    throw runtime_error( "Usage: " + string( argv[0] ) +
+                         " [block %] [out file] [file...]" );
+  }
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    check_usage( argc, argv );
+    run( {argv+3, argv+argc}, argv[2], stod( argv[1] ) );
+  } catch ( const exception & e ) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
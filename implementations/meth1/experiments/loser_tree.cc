@@ -0,0 +1,164 @@
+/**
+ * Compare k-way merge performance of a loser tree against a priority_queue
+ * (pop + push per record, as the Cluster coordinators used to do).
+ *
+ * - Uses own File IO.
+ * - Uses libsort RecordPtr (with a cached key prefix as the merge key).
+ * - Reports records/s for 2 to 256 sorted input runs.
+ */
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "file.hh"
+#include "loser_tree.hh"
+#include "record.hh"
+#include "timestamp.hh"
+
+#include "pq.hh"
+
+using namespace std;
+
+/* Merge key: cached prefix + record. */
+struct Key
+{
+  uint64_t pfx;
+  RecordPtr rec;
+
+  Key( void ) noexcept : pfx{0}, rec{(const char *) nullptr} {}
+  explicit Key( RecordPtr r ) noexcept : pfx{r.prefix()}, rec{r} {}
+
+  bool operator<( const Key & b ) const noexcept
+  {
+    return pfx != b.pfx ? pfx < b.pfx : rec < b.rec;
+  }
+};
+
+/* Key + input run, for the priority_queue. */
+struct RunKey
+{
+  Key key;
+  size_t run;
+
+  bool operator>( const RunKey & b ) const noexcept { return b.key < key; }
+};
+
+using Run = pair<const RecordPtr *, const RecordPtr *>;
+
+void check( const vector<RecordPtr> & out, const char * name )
+{
+  for ( size_t i = 1; i < out.size(); i++ ) {
+    if ( out[i] < out[i - 1] ) {
+      throw runtime_error( string( name ) + " produced an unsorted output" );
+    }
+  }
+}
+
+void merge_pq( vector<Run> runs, vector<RecordPtr> & out )
+{
+  mystl::priority_queue_min<RunKey> pq{runs.size()};
+  for ( size_t i = 0; i < runs.size(); i++ ) {
+    if ( runs[i].first != runs[i].second ) {
+      pq.push( {Key( *runs[i].first++ ), i} );
+    }
+  }
+
+  while ( pq.size() > 0 ) {
+    RunKey rk = pq.top();
+    pq.pop();
+    out.push_back( rk.key.rec );
+    Run & r = runs[rk.run];
+    if ( r.first != r.second ) {
+      pq.push( {Key( *r.first++ ), rk.run} );
+    }
+  }
+}
+
+void merge_lt( vector<Run> runs, vector<RecordPtr> & out )
+{
+  LoserTree<Key> lt{runs.size()};
+  for ( size_t i = 0; i < runs.size(); i++ ) {
+    if ( runs[i].first != runs[i].second ) {
+      lt.set( i, Key( *runs[i].first++ ) );
+    }
+  }
+  lt.build();
+
+  while ( not lt.empty() ) {
+    out.push_back( lt.top_key().rec );
+    Run & r = runs[lt.top()];
+    if ( r.first != r.second ) {
+      lt.replace_top( Key( *r.first++ ) );
+    } else {
+      lt.pop_top();
+    }
+  }
+}
+
+template <typename Merge>
+void time_merge( const char * name, size_t k, const vector<Run> & runs,
+                 size_t nrecs, Merge merge )
+{
+  vector<RecordPtr> out;
+  out.reserve( nrecs );
+
+  auto t0 = time_now();
+  merge( runs, out );
+  auto t = time_diff<ms>( t0 );
+
+  check( out, name );
+  cout << name << ", " << k << ", " << t << ", "
+       << uint64_t( nrecs / ( max( t, tdiff_t( 1 ) ) / 1000.0 ) ) << endl;
+}
+
+void run( char * fin )
+{
+  File fdi( fin, O_RDONLY );
+
+  size_t nrecs = fdi.size() / Rec::SIZE;
+  unique_ptr<char[]> buf( new char[nrecs * Rec::SIZE] );
+  fdi.read_all( buf.get(), nrecs * Rec::SIZE );
+
+  vector<RecordPtr> recs;
+  recs.reserve( nrecs );
+  for ( size_t i = 0; i < nrecs; i++ ) {
+    recs.emplace_back( buf.get() + i * Rec::SIZE, i );
+  }
+
+  cout << "method, inputs, ms, records/s" << endl;
+  for ( size_t k = 2; k <= 256; k *= 2 ) {
+    // split into k sorted runs
+    vector<RecordPtr> sorted( recs );
+    vector<Run> runs;
+    for ( size_t i = 0; i < k; i++ ) {
+      RecordPtr * s = sorted.data() + nrecs * i / k;
+      RecordPtr * e = sorted.data() + nrecs * ( i + 1 ) / k;
+      sort( s, e );
+      runs.emplace_back( s, e );
+    }
+
+    time_merge( "priority_queue", k, runs, nrecs, merge_pq );
+    time_merge( "loser_tree", k, runs, nrecs, merge_lt );
+  }
+}
+
+void check_usage( const int argc, const char * const argv[] )
+{
+  if ( argc != 2 ) {
+    throw runtime_error( "Usage: " + string( argv[0] ) + " [file]" );
+  }
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    check_usage( argc, argv );
+    run( argv[1] );
+  } catch ( const exception & e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include <numeric>
 
 #include "file.hh"
+#include "key_filter.hh"
 #include "overlapped_rec_io.hh"
 #include "linux_compat.hh"
 #include "record.hh"
@@ -63,6 +64,42 @@ void run_inmem_seq( char * rbuf, uint64_t nrecs )
   delete[] recs;
 }
 
+/* Filter using the vectorized key prefix kernel, only copying survivors. */
+uint64_t scan_kernel( char * buf, uint64_t nrecs, RR * out, const RR * after )
+{
+  uint32_t idx[KeyFilter::BATCH];
+  uint64_t lo = after->prefix();
+  size_t zrecs = 0;
+
+  for ( size_t i = 1; i < nrecs; ) {
+    size_t n = min( nrecs - i, KeyFilter::BATCH );
+    const char * rs = buf + Rec::SIZE * i;
+    size_t z = KeyFilter::filter( rs, n, lo, UINT64_MAX, idx );
+    for ( size_t j = 0; j < z; j++ ) {
+      RecordPtr next( rs + Rec::SIZE * idx[j] );
+      if ( *after < next ) {
+        out[zrecs++].copy( next );
+      }
+    }
+    i += n;
+  }
+  return zrecs;
+}
+
+void run_inmem_kernel( char * rbuf, uint64_t nrecs )
+{
+  cout << "kernel, " << KeyFilter::kernel() << endl;
+
+  RR * recs = new RR[nrecs];
+  RR after( rbuf );
+  auto t0 = time_now();
+
+  auto zrecs = scan_kernel( rbuf, nrecs, recs, &after );
+
+  test_end( t0, nrecs, zrecs );
+  delete[] recs;
+}
+
 void run_inmem_par( char * rbuf, uint64_t nrecs, size_t p )
 {
   cout << "parallel, " << p << endl;
@@ -122,7 +159,7 @@ void run_inmem( char * fin )
   cout << endl;
 
   run_inmem_seq( rbuf, nrecs );
-
+  run_inmem_kernel( rbuf, nrecs );
   
   for ( size_t p = 2; p <= thread::hardware_concurrency(); p++ ) {
     run_inmem_par( rbuf, nrecs, p );
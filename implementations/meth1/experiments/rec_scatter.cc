@@ -0,0 +1,160 @@
+/**
+ * Test performance of partitioning records into buckets.
+ *
+ * - Compare a direct memcpy of each record into its bucket's buffer against
+ *   staging them through a write-combining scatter (WCScatter).
+ * - Buckets are equal width ranges of the key space, picked before timing so
+ *   we only measure the copies.
+ */
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "record.hh"
+#include "timestamp.hh"
+#include "wc_scatter.hh"
+
+#define REPEAT 3
+#define STAGE_RECS 4
+
+using namespace std;
+
+using Stage = WCScatter<Rec::SIZE, STAGE_RECS>;
+
+/* A buffer per bucket, each large enough for all of its records (rounded up
+ * to a whole stage) */
+class Buckets
+{
+private:
+  vector<uint8_t *> bufs_;
+
+public:
+  Buckets( const vector<size_t> & counts )
+    : bufs_( counts.size() )
+  {
+    for ( size_t b = 0; b < counts.size(); b++ ) {
+      size_t len = ( counts[b] / STAGE_RECS + 1 ) * Stage::STAGE;
+      if ( posix_memalign( (void **) &bufs_[b], 4096, len ) != 0 ) {
+        throw bad_alloc();
+      }
+      memset( bufs_[b], 0, len ); // fault in before timing
+    }
+  }
+
+  Buckets( const Buckets & ) = delete;
+  Buckets & operator=( const Buckets & ) = delete;
+
+  ~Buckets( void )
+  {
+    for ( auto b : bufs_ ) {
+      free( b );
+    }
+  }
+
+  uint8_t * operator[]( size_t b ) noexcept { return bufs_[b]; }
+};
+
+uint64_t scatter_direct( const uint8_t * recs, const vector<uint16_t> & bkts,
+                         size_t nbkts, Buckets & out )
+{
+  vector<size_t> used( nbkts );
+  auto t0 = time_now();
+  for ( size_t i = 0; i < bkts.size(); i++ ) {
+    uint16_t b = bkts[i];
+    memcpy( out[b] + used[b], recs + i * Rec::SIZE, Rec::SIZE );
+    used[b] += Rec::SIZE;
+  }
+  return time_diff<us>( t0 );
+}
+
+uint64_t scatter_wc( const uint8_t * recs, const vector<uint16_t> & bkts,
+                     size_t nbkts, Buckets & out )
+{
+  vector<size_t> used( nbkts );
+  Stage stage( nbkts );
+  auto t0 = time_now();
+  for ( size_t i = 0; i < bkts.size(); i++ ) {
+    uint16_t b = bkts[i];
+    if ( stage.add( b, recs + i * Rec::SIZE ) ) {
+      used[b] += stage.flush( b, out[b] + used[b] );
+    }
+  }
+  for ( size_t b = 0; b < nbkts; b++ ) {
+    used[b] += stage.flush( b, out[b] + used[b] );
+  }
+  Stage::fence();
+  return time_diff<us>( t0 );
+}
+
+void run( const uint8_t * recs, size_t nrecs, size_t nbkts )
+{
+  // bucket on the first two bytes of the key
+  vector<uint16_t> bkts( nrecs );
+  vector<size_t> counts( nbkts );
+  for ( size_t i = 0; i < nrecs; i++ ) {
+    const uint8_t * k = recs + i * Rec::SIZE;
+    uint32_t prefix = ( uint32_t( k[0] ) << 8 ) | k[1];
+    bkts[i] = prefix * nbkts >> 16;
+    counts[bkts[i]]++;
+  }
+  Buckets out( counts );
+
+  uint64_t tdirect = 0, twc = 0;
+  for ( uint64_t j = 0; j < REPEAT; j++ ) {
+    tdirect += scatter_direct( recs, bkts, nbkts, out );
+    twc += scatter_wc( recs, bkts, nbkts, out );
+  }
+
+  // GB/s == bytes / us / 1000
+  double bytes = double( nrecs ) * Rec::SIZE * REPEAT;
+  cout << "buckets, " << nbkts
+       << ", direct, " << bytes / tdirect / 1000
+       << ", wc, " << bytes / twc / 1000 << endl;
+}
+
+void check_usage( const int argc, const char * const argv[] )
+{
+  if ( argc != 2 ) {
+    throw runtime_error( "Usage: " + string( argv[0] ) + " [file]" );
+  }
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    check_usage( argc, argv );
+
+    FILE *fdi = fopen( argv[1], "r" );
+    if ( fdi == nullptr ) {
+      throw system_error( errno, system_category(), argv[1] );
+    }
+    struct stat st;
+    fstat( fileno( fdi ), &st );
+    size_t nrecs = st.st_size / Rec::SIZE;
+    if ( nrecs == 0 ) {
+      throw runtime_error( "Empty file" );
+    }
+
+    unique_ptr<uint8_t[]> recs( new uint8_t[nrecs * Rec::SIZE] );
+    if ( fread( recs.get(), Rec::SIZE, nrecs, fdi ) != nrecs ) {
+      throw runtime_error( "Short read" );
+    }
+    fclose( fdi );
+
+    cout << "records, " << nrecs << ", stage, " << STAGE_RECS << endl;
+    for ( size_t nbkts = 64; nbkts <= 4096; nbkts *= 2 ) {
+      run( recs.get(), nrecs, nbkts );
+    }
+  } catch ( const exception & e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+/**
+ * Compare our in-place MSD radix sort against the comparison sorts that
+ * `rec_sort` can otherwise dispatch to (std::sort, boost::string_sort and TBB
+ * parallel_sort).
+ *
+ * - Uses own File IO.
+ * - Uses libsort RecordS.
+ * - Writes the radix sorted output so correctness can be checked.
+ */
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <system_error>
+
+#include "file.hh"
+#include "record.hh"
+#include "timestamp.hh"
+
+#include "config.h"
+
+#ifdef HAVE_TBB_PARALLEL_SORT_H
+#include "tbb/parallel_sort.h"
+#endif
+
+#ifdef HAVE_BOOST_SORT_SPREADSORT_STRING_SORT_HPP
+#include <boost/sort/spreadsort/string_sort.hpp>
+#endif
+
+using namespace std;
+using RR = RecordS;
+
+template <typename Sort>
+void time_sort( const char * name, const RR * recs, size_t nrecs, Sort sort )
+{
+  unique_ptr<RR[]> r( new RR[nrecs] );
+  for ( size_t i = 0; i < nrecs; i++ ) {
+    r[i].copy( recs[i] );
+  }
+
+  auto t0 = time_now();
+  sort( r.get(), r.get() + nrecs );
+  cout << name << ", " << time_diff<ms>( t0 ) << endl;
+
+  for ( size_t i = 1; i < nrecs; i++ ) {
+    if ( r[i] < r[i - 1] ) {
+      throw runtime_error( string( name ) + " produced an unsorted output" );
+    }
+  }
+}
+
+void run( char * fin, char * fout )
+{
+  File fdi( fin, O_RDONLY );
+  File fdo( fout, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+
+  size_t nrecs = fdi.size() / Rec::SIZE;
+  unique_ptr<char[]> buf( new char[nrecs * Rec::SIZE] );
+  fdi.read_all( buf.get(), nrecs * Rec::SIZE );
+
+  unique_ptr<RR[]> recs( new RR[nrecs] );
+  for ( size_t i = 0; i < nrecs; i++ ) {
+    recs[i].copy( (uint8_t *) buf.get() + i * Rec::SIZE, i );
+  }
+
+  time_sort( "std::sort", recs.get(), nrecs, []( RR * f, RR * l ) {
+    std::sort( f, l );
+  } );
+#ifdef HAVE_BOOST_SORT_SPREADSORT_STRING_SORT_HPP
+  time_sort( "string_sort", recs.get(), nrecs, []( RR * f, RR * l ) {
+    boost::sort::spreadsort::string_sort( f, l );
+  } );
+#endif
+#ifdef HAVE_TBB_PARALLEL_SORT_H
+  time_sort( "parallel_sort", recs.get(), nrecs, []( RR * f, RR * l ) {
+    tbb::parallel_sort( f, l );
+  } );
+#endif
+  time_sort( "radix_sort", recs.get(), nrecs, []( RR * f, RR * l ) {
+    radix_sort( f, l );
+  } );
+
+  radix_sort( recs.get(), recs.get() + nrecs );
+  for ( size_t i = 0; i < nrecs; i++ ) {
+    recs[i].write( fdo );
+  }
+  fdo.fsync();
+}
+
+void check_usage( const int argc, const char * const argv[] )
+{
+  if ( argc != 3 ) {
+    throw runtime_error( "Usage: " + string( argv[0] ) + " [file] [out]" );
+  }
+}
+
+int main( int argc, char * argv[] )
+{
+  try {
+    check_usage( argc, argv );
+    run( argv[1], argv[2] );
+  } catch ( const exception & e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,4 +1,7 @@
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "buffered_io.hh"
 #include "exception.hh"
@@ -98,6 +101,57 @@ uint64_t Client::recvMaxChunk( void )
   return size;
 }
 
+void Client::sendHistogram( void )
+{
+  rpcStart_ = time_now();
+  int8_t rpc = RPC::HISTOGRAM;
+  sock_.write_all( (char *)&rpc, 1 );
+}
+
+vector<uint64_t> Client::recvHistogram( void )
+{
+  char data[sizeof( uint64_t )];
+  char * nStr = data;
+  sock_.read_all( nStr, sizeof( uint64_t ) );
+  uint64_t n = *reinterpret_cast<const uint64_t *>( nStr );
+
+  vector<uint64_t> hist( n );
+  sock_.read_all( reinterpret_cast<char *>( hist.data() ),
+                  n * sizeof( uint64_t ) );
+
+  print( "histogram", sock_.fd_num(), n, time_diff<ms>( rpcStart_ ) );
+
+  return hist;
+}
+
+void Client::sendReadRanges( const vector<KeyRange> & ranges )
+{
+  rpcStart_ = time_now();
+  uint64_t m = ranges.size();
+
+  string data( 1 + sizeof( uint64_t ) + m * sizeof( KeyRange ), '\0' );
+  data[0] = RPC::READ_RANGES;
+  memcpy( &data[1], &m, sizeof( uint64_t ) );
+  memcpy( &data[1 + sizeof( uint64_t )], ranges.data(),
+          m * sizeof( KeyRange ) );
+  sock_.write_all( data );
+}
+
+vector<char> Client::recvReadRanges( void )
+{
+  char data[sizeof( uint64_t )];
+  char * nStr = data;
+  sock_.read_all( nStr, sizeof( uint64_t ) );
+  uint64_t n = *reinterpret_cast<const uint64_t *>( nStr );
+
+  vector<char> reply( n );
+  sock_.read_all( reply.data(), n );
+
+  print( "read-ranges", sock_.fd_num(), n, time_diff<ms>( rpcStart_ ) );
+
+  return reply;
+}
+
 void Client::sendShutdown( void )
 {
   int8_t rpc = RPC::EXIT;
@@ -1,6 +1,8 @@
 #ifndef METH1_CLIENT_HH
 #define METH1_CLIENT_HH
 
+#include <vector>
+
 #include "address.hh"
 #include "buffered_io.hh"
 #include "socket.hh"
@@ -8,6 +10,8 @@
 
 #include "record.hh"
 
+#include "rpc.hh"
+
 /**
  * Strategy 1.
  * - No upfront work.
@@ -54,6 +58,15 @@ public:
   void sendMaxChunk( void );
   uint64_t recvMaxChunk( void );
 
+  /* Return the server's count of records in each key prefix bucket */
+  void sendHistogram( void );
+  std::vector<uint64_t> recvHistogram( void );
+
+  /* Answer a set of disjoint key ranges (see Node::ReadRanges for the reply
+   * layout) */
+  void sendReadRanges( const std::vector<KeyRange> & ranges );
+  std::vector<char> recvReadRanges( void );
+
   /* Shutdown the backend node */
   void sendShutdown( void );
 };
@@ -1,13 +1,28 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+#ifdef HAVE_TBB_TASK_GROUP_H
+#include "tbb/task_group.h"
+#endif
+
 #include "tune_knobs.hh"
 
+#include "block_writer.hh"
 #include "buffered_io.hh"
 #include "exception.hh"
+#include "loser_tree.hh"
 #include "sync_print.hh"
 #include "util.hh"
 
 #include "cluster.hh"
 #include "meth1_memory.hh"
-#include "priority_queue.hh"
 #include "remote_file.hh"
 
 using namespace std;
@@ -19,6 +34,11 @@ uint64_t calc_client_buffer( size_t nodes )
 
   uint64_t memFree = memory_exists() - Knobs::MEM_RESERVE;
   memFree -= Cluster::WRITE_BUF * Cluster::WRITE_BUF_N;
+  if ( Knobs::CLIENT_MERGE_THREADS > 1 and nodes > 1 ) {
+    memFree -= Knobs::CLIENT_MERGE_BUFFER * Rec::SIZE * nodes;
+    memFree -= Cluster::WRITE_BUF * Rec::SIZE * Cluster::WRITE_BUF_N
+      * Knobs::CLIENT_MERGE_THREADS;
+  }
   return memFree / CircularIO::BLOCK / nodes;
 }
 
@@ -26,6 +46,7 @@ Cluster::Cluster( vector<Address> nodes, uint64_t chunkSize )
   : clients_{}
   , chunkSize_{chunkSize}
   , bufSize_{0}
+  , cum_{}
 {
   for ( auto & n : nodes ) {
     clients_.push_back( Client( n ) );
@@ -101,7 +122,7 @@ void Cluster::Read( uint64_t pos, uint64_t size )
   } else {
     // general n node case
     vector<RemoteFile *> files;
-    mystl::priority_queue_min<RemoteFilePtr> pq{clients_.size()};
+    LoserTree<RemoteKey> lt{clients_.size()};
 
     // prep -- size
     for ( auto & c : clients_ ) {
@@ -126,18 +147,24 @@ void Cluster::Read( uint64_t pos, uint64_t size )
     }
 
     // prep -- 1st record
-    for ( auto f : files ) {
-      f->nextRecord();
-      pq.push( RemoteFilePtr( f ) );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+      if ( files[i]->eof() ) {
+        lt.close( i );
+      } else {
+        files[i]->nextRecord();
+        lt.set( i, RemoteKey( files[i]->curRecord() ) );
+      }
     }
+    lt.build();
 
     // read to end records
-    for ( uint64_t i = 0; i < end; i++ ) {
-      RemoteFilePtr f = pq.top();
-      pq.pop();
-      if ( !f.eof() ) {
-        f.nextRecord();
-        pq.push( f );
+    for ( uint64_t i = 0; i < end and not lt.empty(); i++ ) {
+      RemoteFile * f = files[lt.top()];
+      if ( !f->eof() ) {
+        f->nextRecord();
+        lt.replace_top( RemoteKey( f->curRecord() ) );
+      } else {
+        lt.pop_top();
       }
     }
 
@@ -147,6 +174,193 @@ void Cluster::Read( uint64_t pos, uint64_t size )
   }
 }
 
+/* Sum the key prefix histograms of all nodes into cumulative counts, so that
+ * bucket `b` holds the records of rank [cum[b], cum[b+1]). Cached, as the
+ * nodes' data never changes. */
+const vector<uint64_t> & Cluster::Cumulative( void )
+{
+  if ( cum_.size() > 0 ) {
+    return cum_;
+  }
+
+  for ( auto & c : clients_ ) {
+    c.sendHistogram();
+  }
+
+  vector<uint64_t> hist;
+  for ( auto & c : clients_ ) {
+    auto h = c.recvHistogram();
+    if ( hist.size() == 0 ) {
+      hist = move( h );
+    } else if ( h.size() != hist.size() ) {
+      throw runtime_error( "nodes disagree on histogram size" );
+    } else {
+      for ( size_t b = 0; b < h.size(); b++ ) {
+        hist[b] += h[b];
+      }
+    }
+  }
+
+  cum_.resize( hist.size() + 1 );
+  cum_[0] = 0;
+  for ( size_t b = 0; b < hist.size(); b++ ) {
+    cum_[b + 1] = cum_[b] + hist[b];
+  }
+  return cum_;
+}
+
+/* Retrieve the records at each of `positions` (e.g., for a CDF). The cached
+ * histogram places each rank in a key prefix bucket. We then narrow each
+ * position's key range a byte at a time -- every node counting its records in
+ * the range by their next key byte -- until the range holds at most
+ * READ_MANY_RECORDS records over the cluster (or a single key), and fetch just
+ * those to pick out the rank. A round answers all positions with one pass on
+ * each node, and ships a bounded amount per position even for skewed keys. */
+vector<Record> Cluster::ReadMany( const vector<uint64_t> & positions )
+{
+  static_assert( Knobs::READ_MANY_BUCKET_BITS % 8 == 0 and
+                 Knobs::READ_MANY_BUCKET_BITS <= 32,
+                 "ReadMany buckets must be whole key bytes" );
+  static constexpr size_t FANOUT = 256;
+
+  auto t0 = time_now();
+  auto & cum = Cumulative();
+  uint64_t totalSize = cum.back();
+
+  // key range of each position, with the count and global rank of its records
+  struct Target
+  {
+    KeyRange range;
+    uint64_t below;
+    uint64_t count;
+    bool done;
+  };
+  vector<Target> ts( positions.size() );
+  for ( size_t i = 0; i < positions.size(); i++ ) {
+    if ( positions[i] >= totalSize ) {
+      throw runtime_error( "position outside of range" );
+    }
+    uint32_t b =
+      upper_bound( cum.begin(), cum.end(), positions[i] ) - cum.begin() - 1;
+    Target & t = ts[i];
+    memset( &t.range, 0, sizeof( KeyRange ) );
+    t.range.len = Knobs::READ_MANY_BUCKET_BITS / 8;
+    for ( size_t j = 0; j < t.range.len; j++ ) {
+      t.range.key[j] = b >> ( 8 * ( t.range.len - 1 - j ) );
+    }
+    t.below = cum[b];
+    t.count = cum[b + 1] - cum[b];
+    t.done = false;
+  }
+
+  vector<Record> out( positions.size() );
+  size_t rounds = 0;
+  for ( size_t left = positions.size(); left > 0; rounds++ ) {
+    // distinct ranges of the open positions
+    vector<KeyRange> ranges;
+    vector<size_t> tr( positions.size() );
+    map<string, size_t> seen;
+    for ( size_t i = 0; i < ts.size(); i++ ) {
+      Target & t = ts[i];
+      if ( t.done ) {
+        continue;
+      }
+      t.range.split =
+        t.count > Knobs::READ_MANY_RECORDS and t.range.len < Rec::KEY_LEN;
+      string k( (const char *) t.range.key, t.range.len );
+      auto it = seen.find( k );
+      if ( it == seen.end() ) {
+        it = seen.emplace( k, ranges.size() ).first;
+        ranges.push_back( t.range );
+      }
+      tr[i] = it->second;
+    }
+
+    for ( auto & c : clients_ ) {
+      c.sendReadRanges( ranges );
+    }
+
+    // sum the counts and gather the records of each range over the nodes
+    vector<vector<uint64_t>> counts( ranges.size() );
+    vector<vector<char>> data( ranges.size() );
+    for ( auto & c : clients_ ) {
+      auto reply = c.recvReadRanges();
+      size_t off = 0;
+      auto take = [&reply, &off]( size_t n ) {
+        if ( off + n > reply.size() ) {
+          throw runtime_error( "short key range reply" );
+        }
+        const char * p = reply.data() + off;
+        off += n;
+        return p;
+      };
+      for ( size_t r = 0; r < ranges.size(); r++ ) {
+        if ( ranges[r].split ) {
+          auto p = reinterpret_cast<const uint64_t *>(
+            take( FANOUT * sizeof( uint64_t ) ) );
+          counts[r].resize( FANOUT );
+          for ( size_t b = 0; b < FANOUT; b++ ) {
+            counts[r][b] += p[b];
+          }
+        } else {
+          uint64_t n =
+            *reinterpret_cast<const uint64_t *>( take( sizeof( uint64_t ) ) );
+          auto p = take( n * Rec::SIZE );
+          data[r].insert( data[r].end(), p, p + n * Rec::SIZE );
+        }
+      }
+    }
+
+    vector<vector<RecordPtr>> recs( ranges.size() );
+    for ( size_t r = 0; r < ranges.size(); r++ ) {
+      for ( size_t off = 0; off < data[r].size(); off += Rec::SIZE ) {
+        recs[r].emplace_back( data[r].data() + off );
+      }
+      sort( recs[r].begin(), recs[r].end() );
+    }
+
+    // narrow each open position to the next key byte, or place it
+    for ( size_t i = 0; i < ts.size(); i++ ) {
+      Target & t = ts[i];
+      if ( t.done ) {
+        continue;
+      }
+      size_t r = tr[i];
+      uint64_t rank = positions[i] - t.below;
+      if ( ranges[r].split ) {
+        auto & cnt = counts[r];
+        if ( accumulate( cnt.begin(), cnt.end(), uint64_t( 0 ) ) != t.count ) {
+          throw runtime_error( "key range counts do not match histogram" );
+        }
+        size_t b = 0;
+        while ( rank >= cnt[b] ) {
+          rank -= cnt[b];
+          t.below += cnt[b];
+          b++;
+        }
+        t.range.key[t.range.len++] = b;
+        t.count = cnt[b];
+      } else {
+        // a whole key comes back once per node, as its records are all equal
+        if ( ranges[r].len == Rec::KEY_LEN ) {
+          if ( recs[r].size() == 0 ) {
+            throw runtime_error( "key range records do not match histogram" );
+          }
+          rank = 0;
+        } else if ( recs[r].size() != t.count ) {
+          throw runtime_error( "key range records do not match histogram" );
+        }
+        out[i] = Record( recs[r][rank] );
+        t.done = true;
+        left--;
+      }
+    }
+  }
+  print( "read-many", positions.size(), rounds, time_diff<ms>( t0 ) );
+
+  return out;
+}
+
 void Cluster::ReadAll( void )
 {
   if ( clients_.size() == 1 ) {
@@ -168,7 +382,7 @@ void Cluster::ReadAll( void )
   } else {
     // general n node case
     vector<RemoteFile *> files;
-    mystl::priority_queue_min<RemoteFilePtr> pq{clients_.size()};
+    LoserTree<RemoteKey> lt{clients_.size()};
 
     // prep -- size
     for ( auto & c : clients_ ) {
@@ -189,18 +403,24 @@ void Cluster::ReadAll( void )
     }
 
     // prep -- 1st record
-    for ( auto f : files ) {
-      f->nextRecord();
-      pq.push( RemoteFilePtr( f ) );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+      if ( files[i]->eof() ) {
+        lt.close( i );
+      } else {
+        files[i]->nextRecord();
+        lt.set( i, RemoteKey( files[i]->curRecord() ) );
+      }
     }
+    lt.build();
 
     // read all records
-    for ( uint64_t i = 0; i < totalSize; i++ ) {
-      RemoteFilePtr f = pq.top();
-      pq.pop();
-      if ( !f.eof() ) {
-        f.nextRecord();
-        pq.push( f );
+    for ( uint64_t i = 0; i < totalSize and not lt.empty(); i++ ) {
+      RemoteFile * f = files[lt.top()];
+      if ( !f->eof() ) {
+        f->nextRecord();
+        lt.replace_top( RemoteKey( f->curRecord() ) );
+      } else {
+        lt.pop_top();
       }
     }
 
@@ -210,52 +430,36 @@ void Cluster::ReadAll( void )
   }
 }
 
-static void writer( File out, Channel<vector<Record>> chn )
+void Cluster::WriteAll( File out )
 {
-  tdiff_t tw = 0;
-  BufferedIO bio( out );
-  vector<Record> recs;
-  while ( true ) {
-    try {
-      recs = move( chn.recv() );
-    } catch ( const std::exception & e ) {
-      break; // EOF
-    }
-    auto t0 = time_now();
-    for ( auto const & r : recs ) {
-      r.write( bio );
-    }
-    bio.flush( true );
-    out.fsync();
-    tw += time_diff<ms>( t0 );
+  if ( clients_.size() > 1 and Knobs::CLIENT_MERGE_THREADS > 1 ) {
+    ParallelWriteAll( out );
+    return;
   }
-  print( "write", tw );
-}
 
-void Cluster::WriteAll( File out )
-{
   if ( clients_.size() == 1 ) {
     // optimize for 1 node
     auto & c = clients_.front();
-    BufferedIO bin( c.socket() );
-    BufferedIO bout( out );
+    BlockWriter bout( out, WRITE_BUF * Rec::SIZE, WRITE_BUF_N );
     uint64_t size = Size();
     for ( uint64_t i = 0; i < size; i += chunkSize_ ) {
       c.sendRead( i, chunkSize_ );
       auto nrecs = c.recvRead();
-      for ( uint64_t j = 0; j < nrecs; j++ ) {
-        // XXX: We copy between two buffers and can avoid this.
-        const char * rec = bin.read_buf_all( Rec::SIZE ).first;
-        bout.write_all( rec, Rec::SIZE );
+      // read straight from the socket into the output blocks
+      for ( uint64_t n = nrecs * Rec::SIZE; n > 0; ) {
+        auto buf = bout.buffer();
+        size_t m = min( n, uint64_t( buf.second ) );
+        c.socket().read_all( buf.first, m );
+        bout.commit( m );
+        n -= m;
       }
     }
+    bout.finish();
   } else {
     // general n node case
     vector<RemoteFile *> files;
-    mystl::priority_queue_min<RemoteFilePtr> pq{clients_.size()};
-
-    Channel<vector<Record>> chn( WRITE_BUF_N - 1 );
-    thread twriter( writer, move( out ), chn );
+    LoserTree<RemoteKey> lt{clients_.size()};
+    BlockWriter bout( out, WRITE_BUF * Rec::SIZE, WRITE_BUF_N );
 
     // prep -- size
     for ( auto & c : clients_ ) {
@@ -277,35 +481,30 @@ void Cluster::WriteAll( File out )
     }
 
     // prep -- 1st record
-    for ( auto f : files ) {
-      f->nextRecord();
-      pq.push( RemoteFilePtr( f ) );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+      if ( files[i]->eof() ) {
+        lt.close( i );
+      } else {
+        files[i]->nextRecord();
+        lt.set( i, RemoteKey( files[i]->curRecord() ) );
+      }
     }
+    lt.build();
 
     // read all records
-    vector<Record> recs;
-    recs.reserve( WRITE_BUF );
-    for ( uint64_t i = 0; i < size and pq.size() > 0; i++ ) {
-      RemoteFilePtr f = pq.top();
-      pq.pop();
-      recs.emplace_back( f.curRecord() );
-      if ( !f.eof() ) {
-        f.nextRecord();
-        pq.push( f );
-      }
-      if ( recs.size() >= WRITE_BUF ) {
-        chn.send( move( recs ) );
-        recs = vector<Record>();
+    for ( uint64_t i = 0; i < size and not lt.empty(); i++ ) {
+      RemoteFile * f = files[lt.top()];
+      memcpy( bout.next( Rec::SIZE ), lt.top_key().rec.key(), Rec::SIZE );
+      if ( !f->eof() ) {
+        f->nextRecord();
+        lt.replace_top( RemoteKey( f->curRecord() ) );
+      } else {
+        lt.pop_top();
       }
     }
 
     // wait for write to finish
-    if ( recs.size() > 0 ) {
-      chn.send( move( recs ) );
-    }
-    chn.waitEmpty();
-    chn.close();
-    twriter.join();
+    bout.finish();
 
     for ( auto f : files ) {
       delete f;
@@ -313,6 +512,280 @@ void Cluster::WriteAll( File out )
   }
 }
 
+/* Records that fill a whole number of BlockWriter::ALIGN blocks */
+static constexpr size_t ALIGN_RECS = 1024;
+static_assert( ALIGN_RECS * Rec::SIZE % BlockWriter::ALIGN == 0,
+  "ALIGN_RECS records not block aligned" );
+
+/* A node's records buffered for one round of ParallelWriteAll. */
+struct MergeRun
+{
+  RemoteFile * f;
+  unique_ptr<char[]> buf;
+  size_t n;     // records buffered
+  size_t ready; // records no greater than the round's bound
+  bool done;    // all records received
+
+  const char * rec( size_t i ) const noexcept
+  {
+    return buf.get() + i * Rec::SIZE;
+  }
+};
+
+/* Index of the first record in recs[first, last) that is not less than `key`
+ * (or with `upper`, that is greater than `key`). */
+static size_t rec_bound( const char * recs, size_t first, size_t last,
+                         const RecordPtr & key, bool upper )
+{
+  while ( first < last ) {
+    size_t mid = first + ( last - first ) / 2;
+    RecordPtr r( recs + mid * Rec::SIZE );
+    if ( upper ? not ( key < r ) : r < key ) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+  return first;
+}
+
+/* Keep the records we couldn't merge last round, and top up the rest. */
+static void fill_run( MergeRun & r )
+{
+  memmove( r.buf.get(), r.rec( r.ready ), ( r.n - r.ready ) * Rec::SIZE );
+  r.n -= r.ready;
+  r.ready = 0;
+  for ( ; r.n < Knobs::CLIENT_MERGE_BUFFER and not r.done; r.n++ ) {
+    r.f->nextRecord();
+    memcpy( r.buf.get() + r.n * Rec::SIZE, r.f->curRecord().key(), Rec::SIZE );
+    r.done = r.f->eof();
+  }
+}
+
+/* Move the partition `cut` of the runs (every record before it no greater than
+ * any after it) to have `k` records before it, staying within [lo, hi), by
+ * taking in the smallest records after it or giving up the largest before. */
+static void cut_at( const vector<MergeRun> & runs, vector<size_t> & cut,
+                    const vector<size_t> & lo, const vector<size_t> & hi,
+                    uint64_t k )
+{
+  uint64_t n = 0;
+  for ( auto c : cut ) {
+    n += c;
+  }
+
+  for ( ; n < k; n++ ) {
+    size_t m = runs.size();
+    for ( size_t i = 0; i < runs.size(); i++ ) {
+      if ( cut[i] < hi[i] and ( m == runs.size() or RecordPtr(
+           runs[i].rec( cut[i] ) ) < RecordPtr( runs[m].rec( cut[m] ) ) ) ) {
+        m = i;
+      }
+    }
+    cut[m]++;
+  }
+
+  for ( ; n > k; n-- ) {
+    size_t m = runs.size();
+    for ( size_t i = 0; i < runs.size(); i++ ) {
+      if ( cut[i] > lo[i] and ( m == runs.size() or RecordPtr( runs[m].rec(
+           cut[m] - 1 ) ) < RecordPtr( runs[i].rec( cut[i] - 1 ) ) ) ) {
+        m = i;
+      }
+    }
+    cut[m]--;
+  }
+}
+
+/* Merge runs[i].rec( lo[i] .. hi[i] ) to `out` at byte offset `off`. */
+static void merge_part( const vector<MergeRun> & runs, vector<size_t> lo,
+                        const vector<size_t> & hi, BlockWriter & out,
+                        off_t off )
+{
+  out.seek( off );
+  LoserTree<RemoteKey> lt{runs.size()};
+  for ( size_t i = 0; i < runs.size(); i++ ) {
+    if ( lo[i] < hi[i] ) {
+      lt.set( i, RemoteKey( RecordPtr( runs[i].rec( lo[i] ) ) ) );
+    }
+  }
+  lt.build();
+
+  while ( not lt.empty() ) {
+    size_t i = lt.top();
+    memcpy( out.next( Rec::SIZE ), lt.top_key().rec.key(), Rec::SIZE );
+    if ( ++lo[i] < hi[i] ) {
+      lt.replace_top( RemoteKey( RecordPtr( runs[i].rec( lo[i] ) ) ) );
+    } else {
+      lt.pop_top();
+    }
+  }
+}
+
+/* Multi-node WriteAll with the merge split over CLIENT_MERGE_THREADS.
+ *
+ * We buffer up to CLIENT_MERGE_BUFFER records from each node per round. Any
+ * record no greater than the smallest last buffered record of the nodes that
+ * still have data to send can be merged this round. We sample splitter keys
+ * from those records to partition the key space into ranges of roughly equal
+ * size, and merge each range in parallel straight to its offset in the output
+ * file, each through its own BlockWriter. Ranges (and rounds) are moved to
+ * start on a whole number of ALIGN_RECS records, so every write but the very
+ * last stays block aligned for O_DIRECT. */
+void Cluster::ParallelWriteAll( File & out )
+{
+  const size_t P = Knobs::CLIENT_MERGE_THREADS;
+  static_assert( Knobs::CLIENT_MERGE_BUFFER >= ALIGN_RECS,
+    "a round must hold at least one aligned range" );
+  tdiff_t tf = 0, tm = 0;
+#ifdef HAVE_TBB_TASK_GROUP_H
+  tbb::task_group tg;
+#endif
+
+  vector<MergeRun> runs;
+  for ( auto & c : clients_ ) {
+    runs.push_back( { new RemoteFile( c, chunkSize_, bufSize_ ),
+      unique_ptr<char[]>( new char[Knobs::CLIENT_MERGE_BUFFER * Rec::SIZE] ),
+      0, 0, false } );
+    runs.back().f->sendSize();
+  }
+
+  uint64_t size = 0;
+  for ( auto & r : runs ) {
+    size += r.f->recvSize();
+    r.done = r.f->eof();
+  }
+  print( "\n" );
+
+  for ( auto & r : runs ) {
+    r.f->nextChunk();
+  }
+
+  // constructed (and finished in reverse) one at a time, so that only the
+  // first changes the file's O_DIRECT flag, and restores it last
+  vector<unique_ptr<BlockWriter>> bouts;
+  for ( size_t p = 0; p < P; p++ ) {
+    bouts.emplace_back( new BlockWriter( out, WRITE_BUF * Rec::SIZE,
+                                         WRITE_BUF_N ) );
+  }
+
+  uint64_t written = 0;
+  while ( written < size ) {
+    // FILL
+    auto t0 = time_now();
+    for ( auto & r : runs ) {
+#ifdef HAVE_TBB_TASK_GROUP_H
+      tg.run( [&r]() { fill_run( r ); } );
+#else
+      fill_run( r );
+#endif
+    }
+#ifdef HAVE_TBB_TASK_GROUP_H
+    tg.wait();
+#endif
+    tf += time_diff<ms>( t0 );
+
+    // BOUND
+    auto t1 = time_now();
+    const char * bound = nullptr;
+    for ( auto & r : runs ) {
+      if ( not r.done ) {
+        const char * last = r.rec( r.n - 1 );
+        if ( bound == nullptr or RecordPtr( last ) < RecordPtr( bound ) ) {
+          bound = last;
+        }
+      }
+    }
+
+    uint64_t total = 0;
+    for ( auto & r : runs ) {
+      r.ready = bound == nullptr
+        ? r.n : rec_bound( r.rec( 0 ), 0, r.n, RecordPtr( bound ), true );
+      total += r.ready;
+    }
+    if ( total == 0 ) {
+      throw runtime_error( "nodes sent fewer records than expected" );
+    }
+
+    // every node still sending has CLIENT_MERGE_BUFFER records ready, so we
+    // can always end a round other than the last on an aligned record
+    if ( written + total < size ) {
+      vector<size_t> zero( runs.size() ), ready( runs.size() );
+      for ( size_t i = 0; i < runs.size(); i++ ) {
+        ready[i] = runs[i].ready;
+      }
+      uint64_t end = ( written + total ) / ALIGN_RECS * ALIGN_RECS;
+      cut_at( runs, ready, zero, ready, end - written );
+      for ( size_t i = 0; i < runs.size(); i++ ) {
+        runs[i].ready = ready[i];
+      }
+      total = end - written;
+    }
+
+    // SPLIT
+    size_t parts = max( size_t( 1 ), min( P, size_t( total / WRITE_BUF ) ) );
+    size_t step = max( uint64_t( 1 ), total / ( parts * 64 ) );
+    vector<RecordPtr> sample;
+    for ( auto & r : runs ) {
+      for ( size_t i = 0; i < r.ready; i += step ) {
+        sample.emplace_back( r.rec( i ) );
+      }
+    }
+    sort( sample.begin(), sample.end() );
+
+    // cuts[p][i] -- start of range p in run i
+    vector<vector<size_t>> cuts( parts + 1, vector<size_t>( runs.size() ) );
+    for ( size_t i = 0; i < runs.size(); i++ ) {
+      cuts[0][i] = 0;
+      cuts[parts][i] = runs[i].ready;
+    }
+    for ( size_t p = 1; p < parts; p++ ) {
+      const RecordPtr & split = sample[sample.size() * p / parts];
+      uint64_t start = 0;
+      for ( size_t i = 0; i < runs.size(); i++ ) {
+        cuts[p][i] = rec_bound( runs[i].rec( 0 ), cuts[p - 1][i],
+                                runs[i].ready, split, false );
+        start += cuts[p][i];
+      }
+      start = ( written + start ) / ALIGN_RECS * ALIGN_RECS - written;
+      cut_at( runs, cuts[p], cuts[p - 1], cuts[parts], start );
+    }
+
+    // MERGE
+    uint64_t off = written;
+    for ( size_t p = 0; p < parts; p++ ) {
+      BlockWriter * bout = bouts[p].get();
+      off_t boff = off * Rec::SIZE;
+#ifdef HAVE_TBB_TASK_GROUP_H
+      tg.run( [&runs, &cuts, p, bout, boff]() {
+        merge_part( runs, cuts[p], cuts[p + 1], *bout, boff );
+      } );
+#else
+      merge_part( runs, cuts[p], cuts[p + 1], *bout, boff );
+#endif
+      for ( size_t i = 0; i < runs.size(); i++ ) {
+        off += cuts[p + 1][i] - cuts[p][i];
+      }
+    }
+#ifdef HAVE_TBB_TASK_GROUP_H
+    tg.wait();
+#endif
+    written += total;
+    tm += time_diff<ms>( t1 );
+  }
+
+  for ( size_t p = P; p > 0; p-- ) {
+    bouts[p - 1]->finish();
+  }
+
+  print( "fill", tf );
+  print( "merge", tm );
+
+  for ( auto & r : runs ) {
+    delete r.f;
+  }
+}
+
 void Cluster::Shutdown( void )
 {
   for ( auto & c : clients_ ) {
@@ -30,6 +30,13 @@ private:
   uint64_t chunkSize_;
   uint64_t bufSize_;
 
+  /* ReadMany -- cluster-wide count of records below each key prefix bucket */
+  std::vector<uint64_t> cum_;
+
+  const std::vector<uint64_t> & Cumulative( void );
+
+  void ParallelWriteAll( File & out );
+
 public:
   static size_t constexpr WRITE_BUF = Knobs::CLIENT_WRITE_BUFFER;
   static size_t constexpr WRITE_BUF_N = 2;
@@ -39,6 +46,7 @@ public:
   uint64_t Size( void );
   Record ReadFirst( void );
   void Read( uint64_t pos, uint64_t size );
+  std::vector<Record> ReadMany( const std::vector<uint64_t> & positions );
   void ReadAll( void );
   void WriteAll( File out );
   void Shutdown( void );
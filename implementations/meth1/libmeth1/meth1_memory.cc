@@ -2,6 +2,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <system_error>
+#include <utility>
 
 #include "tune_knobs.hh"
 
@@ -55,7 +56,8 @@ size_t calc_value_size( void )
   // return min( val_len, 2 * Rec::VAL_LEN );
 
   // XXX: Just hard-code for now due to difference between client & backend
-  size_t val_len = 112;
+  // (the slab allocator packs values, malloc has ~22 bytes overhead)
+  size_t val_len = Knobs::SLAB_ALLOC ? Rec::VAL_LEN : 112;
   print( "record-value", val_len );
   return val_len;
 }
@@ -73,14 +75,23 @@ uint64_t calc_record_space( void )
 
   // remove fixed buffers
   memFree -= Knobs::MEM_RESERVE;
-  memFree -= ( Knobs::IO_BUFFER_NETW * Rec::SIZE * 2 );
   memFree -= ( CircularIO::BLOCK * Knobs::DISK_BLOCKS * num_of_disks() );
 
-  // divisor for r2 & r3 merge buffers
-  uint64_t div1 = uint64_t( 2 ) * uint64_t( sizeof( Node::RR ) ) + val_len;
-  // divisor for r1 sort buffer
-  uint64_t div2 = ( uint64_t( sizeof( Node::RR ) ) + val_len )
-    / Knobs::SORT_MERGE_RATIO;
+  uint64_t div1, div2;
+  if ( Knobs::INDEX_SORT ) {
+    // divisor for r2 & r3 merge buffers, the gather list + network buffer
+    div1 = uint64_t( 2 ) * uint64_t( sizeof( Node::RI ) )
+      + uint64_t( sizeof( pair<uint64_t, uint64_t> ) ) + Rec::SIZE;
+    // divisor for r1 sort buffer
+    div2 = uint64_t( sizeof( Node::RI ) ) / Knobs::SORT_MERGE_RATIO;
+  } else {
+    memFree -= ( Knobs::IO_BUFFER_NETW * Rec::SIZE * 2 );
+    // divisor for r2 & r3 merge buffers
+    div1 = uint64_t( 2 ) * uint64_t( sizeof( Node::RR ) ) + val_len;
+    // divisor for r1 sort buffer
+    div2 = ( uint64_t( sizeof( Node::RR ) ) + val_len )
+      / Knobs::SORT_MERGE_RATIO;
+  }
 
   // divide by sort + merge buffers
   memFree /= ( div1 + div2 );
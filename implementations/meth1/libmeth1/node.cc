@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cstring>
 #include <numeric>
+#include <utility>
 
 #include "tune_knobs.hh"
 
@@ -28,6 +31,9 @@ Node::Node( vector<string> files, string port, bool odirect )
   , seek_chunk_{calc_record_space()}
   , lpass_{0}
   , size_{0}
+  , lastIdx_{}
+  , netbuf_{}
+  , hist_{}
 {
   if ( files.size() <= 0 ) {
     throw runtime_error( "No files to read from" );
@@ -35,7 +41,7 @@ Node::Node( vector<string> files, string port, bool odirect )
 
   print( "seek-chunk", seek_chunk_ );
   for ( auto & f : files ) {
-    recios_.emplace_back( f, O_RDONLY, odirect );
+    recios_.emplace_back( f, O_RDONLY, odirect, recios_.size() );
     print( "file", recios_.back().id(), recios_.back().records() );
   }
 }
@@ -71,6 +77,12 @@ void Node::Run( void )
         case RPC::MAX_CHUNK:
           RPC_MaxChunk( client );
           break;
+        case RPC::HISTOGRAM:
+          RPC_Histogram( client );
+          break;
+        case RPC::READ_RANGES:
+          RPC_ReadRanges( client );
+          break;
         case RPC::EXIT:
           print( "\nexit", timestamp<ms>() );
           return;
@@ -88,11 +100,6 @@ void Node::Run( void )
 
 void Node::RPC_Read( TCPSocket & client )
 {
-  static uint64_t pass = 0;
-
-  static char * buf1 = new char[Knobs::IO_BUFFER_NETW * Rec::SIZE];
-  static char * buf2 = new char[Knobs::IO_BUFFER_NETW * Rec::SIZE];
-
   constexpr size_t rpcSize = 2 * sizeof( uint64_t );
   char strArray[rpcSize];
   char * rpcData = strArray; // work-around strict-aliasing rules
@@ -102,6 +109,16 @@ void Node::RPC_Read( TCPSocket & client )
   uint64_t pos = *( reinterpret_cast<const uint64_t *>( rpcData ) );
   uint64_t amt = *( reinterpret_cast<const uint64_t *>( rpcData ) + 1 );
 
+  if ( Knobs::INDEX_SORT ) {
+    RPC_ReadIdx( client, pos, amt );
+    return;
+  }
+
+  static uint64_t pass = 0;
+
+  static char * buf1 = new char[Knobs::IO_BUFFER_NETW * Rec::SIZE];
+  static char * buf2 = new char[Knobs::IO_BUFFER_NETW * Rec::SIZE];
+
   RecV recs;
   if ( pos < Size() ) {
     recs = Read( pos, amt );
@@ -173,6 +190,38 @@ void Node::RPC_Read( TCPSocket & client )
   print( "network", ++pass, time_diff<ms>( t0 ) );
 }
 
+/* Read with INDEX_SORT -- gather the records straight into the network buffer,
+ * which we send in one go. */
+void Node::RPC_ReadIdx( TCPSocket & client, uint64_t pos, uint64_t amt )
+{
+  static uint64_t pass = 0;
+
+  IdxV recs;
+  if ( pos < Size() ) {
+    recs = ReadIdx( pos, amt );
+  }
+
+  auto t0 = time_now();
+  uint64_t siz = recs.size();
+  if ( netbufx_ < siz ) {
+    netbuf_.reset( new char[siz * Rec::SIZE] );
+    netbufx_ = siz;
+  }
+  Gather( recs, netbuf_.get() );
+  auto t1 = time_now();
+
+  client.write_all( reinterpret_cast<const char *>( &siz ), sizeof( uint64_t ) );
+  client.write_all( netbuf_.get(), siz * Rec::SIZE );
+
+  if ( not Knobs::REUSE_MEM ) {
+    netbuf_.reset();
+    netbufx_ = 0;
+  }
+
+  print( "gather", pass + 1, time_diff<ms>( t1, t0 ) );
+  print( "network", ++pass, time_diff<ms>( t1 ) );
+}
+
 void Node::RPC_Size( TCPSocket & client )
 {
   uint64_t siz = Size();
@@ -186,6 +235,32 @@ void Node::RPC_MaxChunk( TCPSocket & client )
                     sizeof( uint64_t ) );
 }
 
+void Node::RPC_Histogram( TCPSocket & client )
+{
+  auto & hist = Histogram();
+  uint64_t n = hist.size();
+  client.write_all( reinterpret_cast<const char *>( &n ), sizeof( uint64_t ) );
+  client.write_all( reinterpret_cast<const char *>( hist.data() ),
+                    n * sizeof( uint64_t ) );
+}
+
+void Node::RPC_ReadRanges( TCPSocket & client )
+{
+  char data[sizeof( uint64_t )];
+  char * mStr = data;
+  client.read_all( mStr, sizeof( uint64_t ) );
+  uint64_t m = *reinterpret_cast<const uint64_t *>( mStr );
+
+  vector<KeyRange> ranges( m );
+  client.read_all( reinterpret_cast<char *>( ranges.data() ),
+                   m * sizeof( KeyRange ) );
+
+  auto out = ReadRanges( ranges );
+  uint64_t siz = out.size();
+  client.write_all( reinterpret_cast<const char *>( &siz ), sizeof( uint64_t ) );
+  client.write_all( out.data(), out.size() );
+}
+
 Node::RecV Node::Read( uint64_t pos, uint64_t size )
 {
   static size_t pass = 0;
@@ -211,6 +286,222 @@ Node::RecV Node::Read( uint64_t pos, uint64_t size )
   return recs;
 }
 
+Node::IdxV Node::ReadIdx( uint64_t pos, uint64_t size )
+{
+  static size_t pass = 0;
+  if ( pos + size > Size() ) {
+    size = Size() - pos;
+  }
+
+  if ( size > seek_chunk_ ) {
+    print( "chunk-too-large", size, seek_chunk_ );
+    throw runtime_error( "Requested read is too large" );
+  }
+
+  print( "\nread-start", ++pass, pos, size, timestamp<ms>() );
+
+  auto t0 = time_now();
+  auto recs = linear_scan_idx( seek_idx( pos ), size );
+  if ( recs.size() > 0 ) {
+    lastIdx_ = recs.back();
+    ipos_ = pos + recs.size();
+  }
+  print( "read", pass, recs.size(), time_diff<ms>( t0 ) );
+
+  return recs;
+}
+
+/* Copy out the full records for `recs`, reading all files in parallel. */
+void Node::Gather( IdxV & recs, char * out )
+{
+  // (record number, rank) for each file, in disk order
+  vector<vector<pair<uint64_t, uint64_t>>> locs( recios_.size() );
+  uint64_t rank = 0;
+  for ( auto & r : recs ) {
+    locs[r.file()].emplace_back( r.rec(), rank++ );
+  }
+
+  for ( size_t i = 0; i < recios_.size(); i++ ) {
+    auto & rio = recios_[i];
+    auto & loc = locs[i];
+    if ( loc.size() == 0 ) {
+      continue;
+    }
+#ifdef HAVE_TBB_TASK_GROUP_H
+    tg_.run( [&rio, &loc, out]() {
+      sort( loc.begin(), loc.end() );
+      rio.gather( loc.data(), loc.data() + loc.size(), out );
+    } );
+#else
+    sort( loc.begin(), loc.end() );
+    rio.gather( loc.data(), loc.data() + loc.size(), out );
+#endif
+  }
+#ifdef HAVE_TBB_TASK_GROUP_H
+  tg_.wait();
+#endif
+}
+
+/* Bucket of a record for ReadMany -- the top bits of its key prefix. */
+static inline uint32_t key_bucket( const RecordPtr & r )
+{
+  return r.prefix() >> ( 64 - Knobs::READ_MANY_BUCKET_BITS );
+}
+
+/* Count the records in each key prefix bucket. Built with one pass over the
+ * files on first use and then cached, as the node's data never changes. */
+const vector<uint64_t> & Node::Histogram( void )
+{
+  if ( hist_.size() > 0 ) {
+    return hist_;
+  }
+
+  auto t0 = time_now();
+  const size_t nb = size_t( 1 ) << Knobs::READ_MANY_BUCKET_BITS;
+  vector<vector<uint64_t>> hists( recios_.size(), vector<uint64_t>( nb ) );
+  for ( size_t i = 0; i < recios_.size(); i++ ) {
+    RecLoader & rio = recios_[i];
+    vector<uint64_t> * hist = &hists[i];
+
+    rio.rewind();
+#ifdef HAVE_TBB_TASK_GROUP_H
+    tg_.run( [&rio, hist]() {
+      while ( true ) {
+        RecordPtr next = rio.next_record();
+        if ( rio.eof() ) {
+          break;
+        }
+        (*hist)[key_bucket( next )]++;
+      }
+    } );
+#else
+    while ( true ) {
+      RecordPtr next = rio.next_record();
+      if ( rio.eof() ) {
+        break;
+      }
+      (*hist)[key_bucket( next )]++;
+    }
+#endif
+  }
+#ifdef HAVE_TBB_TASK_GROUP_H
+  tg_.wait();
+#endif
+
+  hist_ = move( hists[0] );
+  for ( size_t i = 1; i < hists.size(); i++ ) {
+    for ( size_t b = 0; b < nb; b++ ) {
+      hist_[b] += hists[i][b];
+    }
+  }
+  print( "histogram", nb, time_diff<ms>( t0 ) );
+
+  return hist_;
+}
+
+/* Answer a set of disjoint key ranges for ReadMany (see KeyRange) with a
+ * single pass over the files. */
+vector<char> Node::ReadRanges( const vector<KeyRange> & ranges )
+{
+  static constexpr size_t FANOUT = 256;
+
+  auto t0 = time_now();
+  for ( auto & r : ranges ) {
+    if ( r.len > Rec::KEY_LEN or ( r.split and r.len == Rec::KEY_LEN ) ) {
+      throw runtime_error( "Key range outside of range" );
+    }
+  }
+
+  // ranges by key, as a key can then only fall in the last range starting at
+  // or below it
+  vector<size_t> order( ranges.size() );
+  iota( order.begin(), order.end(), 0 );
+  sort( order.begin(), order.end(), [&ranges]( size_t a, size_t b ) {
+    return memcmp( ranges[a].key, ranges[b].key, Rec::KEY_LEN ) < 0;
+  } );
+
+  // each file's counts (FANOUT per range) and records per range
+  vector<vector<uint64_t>> counts( recios_.size(),
+                                   vector<uint64_t>( ranges.size() * FANOUT ) );
+  vector<vector<vector<char>>> recs( recios_.size(),
+                                     vector<vector<char>>( ranges.size() ) );
+
+  auto scan = [&ranges, &order]( RecLoader & rio, vector<uint64_t> * cnt,
+                                 vector<vector<char>> * rv ) {
+    while ( true ) {
+      RecordPtr next = rio.next_record();
+      if ( rio.eof() ) {
+        break;
+      }
+      auto it = upper_bound( order.begin(), order.end(), next.key(),
+        [&ranges]( const uint8_t * k, size_t i ) {
+          return memcmp( k, ranges[i].key, Rec::KEY_LEN ) < 0;
+        } );
+      if ( it == order.begin() ) {
+        continue;
+      }
+      size_t i = *( it - 1 );
+      const KeyRange & r = ranges[i];
+      if ( memcmp( next.key(), r.key, r.len ) != 0 ) {
+        continue;
+      }
+      if ( r.split ) {
+        (*cnt)[i * FANOUT + next.key()[r.len]]++;
+      } else if ( r.len < Rec::KEY_LEN or (*rv)[i].size() == 0 ) {
+        (*rv)[i].insert( (*rv)[i].end(), next.data(),
+                         next.data() + Rec::SIZE );
+      }
+    }
+  };
+
+  for ( size_t i = 0; i < recios_.size(); i++ ) {
+    RecLoader & rio = recios_[i];
+    vector<uint64_t> * cnt = &counts[i];
+    vector<vector<char>> * rv = &recs[i];
+
+    rio.rewind();
+#ifdef HAVE_TBB_TASK_GROUP_H
+    tg_.run( [&scan, &rio, cnt, rv]() { scan( rio, cnt, rv ); } );
+#else
+    scan( rio, cnt, rv );
+#endif
+  }
+#ifdef HAVE_TBB_TASK_GROUP_H
+  tg_.wait();
+#endif
+
+  // pack the answers in request order
+  vector<char> out;
+  auto put = [&out]( const void * p, size_t n ) {
+    out.insert( out.end(), (const char *) p, (const char *) p + n );
+  };
+  for ( size_t i = 0; i < ranges.size(); i++ ) {
+    if ( ranges[i].split ) {
+      vector<uint64_t> sum( FANOUT );
+      for ( auto & cnt : counts ) {
+        for ( size_t b = 0; b < FANOUT; b++ ) {
+          sum[b] += cnt[i * FANOUT + b];
+        }
+      }
+      put( sum.data(), FANOUT * sizeof( uint64_t ) );
+    } else {
+      vector<char> all;
+      for ( auto & rv : recs ) {
+        all.insert( all.end(), rv[i].begin(), rv[i].end() );
+      }
+      if ( ranges[i].len == Rec::KEY_LEN and all.size() > Rec::SIZE ) {
+        all.resize( Rec::SIZE );
+      }
+      uint64_t n = all.size() / Rec::SIZE;
+      put( &n, sizeof( uint64_t ) );
+      put( all.data(), all.size() );
+    }
+  }
+  print( "read-ranges", ranges.size(), out.size(), time_diff<ms>( t0 ) );
+
+  return out;
+}
+
 uint64_t Node::Size( void )
 {
   if ( size_ == 0 ) {
@@ -241,6 +532,30 @@ Record Node::seek( uint64_t pos )
   return last_;
 }
 
+/* As seek, but for INDEX_SORT. Returns nullptr when there is no lower bound
+ * (i.e., `pos` is 0). */
+const Node::RI * Node::seek_idx( uint64_t pos )
+{
+  if ( pos == 0 ) {
+    return nullptr;
+  } else if ( pos >= Size() ) {
+    lastIdx_ = RI( Rec::MAX );
+  } else if ( ipos_ != pos ) {
+    // remember, retrieving the record just before `pos`
+    const RI * after = nullptr;
+    for ( uint64_t i = 0; i < pos; i += seek_chunk_ ) {
+      auto recs = linear_scan_idx( after, min( pos - i, seek_chunk_ ) );
+      if ( recs.size() == 0 ) {
+        break;
+      }
+      lastIdx_ = recs.back();
+      after = &lastIdx_;
+    }
+    ipos_ = pos;
+  }
+  return &lastIdx_;
+}
+
 /* Perform a single linear scan of the file, returning the next `size` smallest
  * records that occur directly after the `after` record. */
 Node::RecV Node::linear_scan( const Record & after, uint64_t size )
@@ -312,15 +627,17 @@ Node::RecV Node::linear_scan_one( const Record & after )
   return {move( rec )};
 }
 
-/* Linear scan using a chunked sorting + merge strategy. */
-Node::RecV Node::linear_scan_chunk( const Record & after, uint64_t size,
-    RR * r1, RR * r2, RR *r3, uint64_t r1x )
+/* Linear scan using a chunked sorting + merge strategy. Works over either full
+ * records (RR) or (key, location) tuples (RI). */
+template <typename T, typename A>
+RawVector<T> Node::linear_scan_chunk( const A & after, uint64_t size,
+    T * r1, T * r2, T *r3, uint64_t r1x )
 {
   auto t0 = time_now();
   tdiff_t tm = 0, ts = 0, tl = 0;
   size_t merges = 0, sorts = 0;
 
-  const RR * curMin = nullptr;
+  const T * curMin = nullptr;
   const uint64_t r1x_i = r1x / recios_.size();
   vector<uint64_t> r1s_i( recios_.size() );
   uint64_t r2s = 0;
@@ -417,6 +734,7 @@ void Node::free_buffers( Node::RR * r1, Node::RR * r3, size_t size )
   }
   delete[] r3;
   delete[] r1;
+  Rec::trim_vals();
 }
 
 /* Memory management for linear_scan_chunk */
@@ -473,3 +791,52 @@ Node::RecV Node::linear_scan_chunk( const Record & after, uint64_t size )
 
   return rr;
 }
+
+/* Memory management for linear_scan_chunk with INDEX_SORT */
+Node::IdxV Node::linear_scan_idx( const RI * after, uint64_t size )
+{
+  if ( size == 0 ) {
+    return {nullptr, 0};
+  }
+
+  // local variables
+  RI *r1, *r2, *r3;
+  size_t r1x = max( Knobs::SORT_MERGE_LOWER, size / Knobs::SORT_MERGE_RATIO );
+
+  if ( Knobs::REUSE_MEM ) {
+    // (re-)setup global buffers if size isn't correct
+    if ( gi2x < size ) {
+      delete[] gi1;
+      delete[] gi2;
+      delete[] gi3;
+      gi1x = r1x;
+      gi2x = size;
+      gi1 = new RI[gi1x];
+      gi2 = new RI[gi2x];
+      gi3 = new RI[gi2x];
+    }
+    r1 = gi1; r2 = gi2; r3 = gi3;
+  } else {
+    r1 = new RI[r1x];
+    r2 = new RI[size];
+    r3 = new RI[size];
+  }
+
+  auto rr = linear_scan_chunk( after, size, r1, r2, r3, r1x );
+  if ( rr.data() == r3 ) {
+    swap( r2, r3 );
+    if ( Knobs::REUSE_MEM ) {
+      swap( gi2, gi3 );
+    }
+  }
+
+  if ( not Knobs::REUSE_MEM ) {
+    delete[] r3;
+    delete[] r1;
+  } else {
+    /* we don't want r2 being freed later! */
+    rr.own() = false;
+  }
+
+  return rr;
+}
@@ -1,6 +1,7 @@
 #ifndef METH1_NODE_HH
 #define METH1_NODE_HH
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,7 @@
 
 #include "record.hh"
 #include "rec_loader.hh"
+#include "rpc.hh"
 
 /**
  * Stratergy 1.
@@ -33,6 +35,8 @@ class Node
 public:
   using RR = RecordS;
   using RecV = RawVector<RR>;
+  using RI = RecordIdx;
+  using IdxV = RawVector<RI>;
 
 private:
 #ifdef HAVE_TBB_TASK_GROUP_H
@@ -53,6 +57,20 @@ private:
   RR * gr2 = nullptr;
   RR * gr3 = nullptr;
 
+  // for INDEX_SORT (and REUSE_MEM)
+  RI lastIdx_;
+  uint64_t ipos_ = 0;
+  size_t gi1x = 0;
+  size_t gi2x = 0;
+  RI * gi1 = nullptr;
+  RI * gi2 = nullptr;
+  RI * gi3 = nullptr;
+  std::unique_ptr<char[]> netbuf_;
+  size_t netbufx_ = 0;
+
+  // for ReadMany -- key prefix histogram, built on first use
+  std::vector<uint64_t> hist_;
+
   void free_buffers( RR * r1, RR * r3, size_t size );
 
 public:
@@ -73,6 +91,9 @@ public:
     if ( gr2 != nullptr ) {
       delete[] gr2;
     }
+    delete[] gi1;
+    delete[] gi2;
+    delete[] gi3;
   }
 
   /* Run the node - list and respond to RPCs */
@@ -83,18 +104,37 @@ public:
   RecV Read( uint64_t pos, uint64_t size );
   uint64_t Size( void );
 
+  /* INDEX_SORT API -- read just the (key, location) tuples, and then gather
+   * the full records for them into `out` (sized for `recs.size()` records) in
+   * a single pass over the files. */
+  IdxV ReadIdx( uint64_t pos, uint64_t size );
+  void Gather( IdxV & recs, char * out );
+
+  /* ReadMany API -- count of records falling in each key prefix bucket, and
+   * the answer for each of a set of disjoint key ranges (see KeyRange), found
+   * in a single pass and packed in order: 256 counts for a split range, else
+   * a record count followed by the (unsorted) records. */
+  const std::vector<uint64_t> & Histogram( void );
+  std::vector<char> ReadRanges( const std::vector<KeyRange> & ranges );
+
 private:
   Record seek( uint64_t pos );
+  const RI * seek_idx( uint64_t pos );
 
   RecV linear_scan( const Record & after, uint64_t size = 1 );
   RecV linear_scan_one( const Record & after );
-  RecV linear_scan_chunk( const Record & after, uint64_t size,
-                          RR * r1, RR * r2, RR *r3, uint64_t r1x );
+  template <typename T, typename A>
+  RawVector<T> linear_scan_chunk( const A & after, uint64_t size,
+                                  T * r1, T * r2, T *r3, uint64_t r1x );
   RecV linear_scan_chunk( const Record & after, uint64_t size );
+  IdxV linear_scan_idx( const RI * after, uint64_t size );
 
   void RPC_Read( TCPSocket & client );
+  void RPC_ReadIdx( TCPSocket & client, uint64_t pos, uint64_t amt );
   void RPC_Size( TCPSocket & client );
   void RPC_MaxChunk( TCPSocket & client );
+  void RPC_Histogram( TCPSocket & client );
+  void RPC_ReadRanges( TCPSocket & client );
 };
 }
 
@@ -1,7 +1,13 @@
+#include <algorithm>
+#include <cstring>
+
 #include "sync_print.hh"
 
+#include "key_filter.hh"
 #include "rec_loader.hh"
 
+using namespace std;
+
 void RecLoader::rewind( void )
 {
   loc_ = 0;
@@ -25,44 +31,94 @@ uint64_t RecLoader::filter( RR * r1, uint64_t size, const Record & after,
     return 0;
   }
 
-  if ( curMin == nullptr ) {
-    for ( uint64_t i = 0; i < size; loc_++ ) {
-      const uint8_t * r = (const uint8_t *) rio_->next_record();
-      if ( r == nullptr ) {
-        eof_ = true;
-        return i;
-      }
-      if ( after.compare( r, loc_ ) < 0 ) {
-        r1[i++].copy( r, loc_ );
-      // } else if ( after.compare( r, loc_ ) == 0 ) {
-      //   print( "duplicate-rec", 1, after );
-      //   r1[i++].copy( r, loc_ );
-      }
+  // range test a run of records at a time on their key prefix, only falling
+  // back to a full comparison when a prefix ties with one of the bounds
+  uint32_t idx[KeyFilter::BATCH];
+  uint64_t lo = after.prefix();
+  uint64_t hi = curMin == nullptr ? UINT64_MAX : curMin->prefix();
+
+  for ( uint64_t i = 0; i < size; ) {
+    size_t n;
+    const char * rs =
+      rio_->next_records( min( size - i, KeyFilter::BATCH ), n );
+    if ( rs == nullptr ) {
+      eof_ = true;
+      return i;
     }
-  } else {
-    for ( uint64_t i = 0; i < size; loc_++ ) {
-      const uint8_t * r = (const uint8_t *) rio_->next_record();
-      if ( r == nullptr ) {
-        eof_ = true;
-        return i;
+
+    size_t z = KeyFilter::filter( rs, n, lo, hi, idx );
+    for ( size_t j = 0; j < z; j++ ) {
+      const uint8_t * r = (const uint8_t *) rs + idx[j] * Rec::SIZE;
+      uint64_t loc = loc_ + idx[j];
+      uint64_t p = Rec::key_prefix( r );
+      if ( p == lo or p == hi ) {
+        if ( after.compare( r, loc ) >= 0 or
+             ( curMin != nullptr and curMin->compare( r, loc ) <= 0 ) ) {
+          continue;
+        }
       }
-      if ( after.compare( r, loc_ ) < 0 and
-           curMin->compare( r, loc_ ) > 0 ) {
-        r1[i++].copy( r, loc_ );
-      // } else if ( after.compare( r, loc_ ) == 0 and
-      //        curMin->compare( r, loc_ ) > 0 ) {
-      //   print( "duplicate-rec", 2, after );
-      //   r1[i++].copy( r, loc_ );
-      // } else if ( after.compare( r, loc_ ) < 0 and
-      //        curMin->compare( r, loc_ ) == 0 ) {
-      //   print( "duplicate-rec", 3, curMin );
-      //   r1[i++].copy( r, loc_ );
-      // } else if ( after.compare( r, loc_ ) == 0 and
-      //        curMin->compare( r, loc_ ) == 0 ) {
-      //   print( "duplicate-rec", 4, after, curMin );
-      //   r1[i++].copy( r, loc_ );
+      r1[i++].copy( r, loc );
+    }
+    loc_ += n;
+  }
+  return size;
+}
+
+uint64_t RecLoader::filter( RecordIdx * r1, uint64_t size,
+                            const RecordIdx * after,
+                            const RecordIdx * const curMin )
+{
+  if ( eof_ ) {
+    return 0;
+  }
+
+  // as for RecordS, but a tie on prefix is resolved on the packed tuple
+  uint32_t idx[KeyFilter::BATCH];
+  uint64_t lo = after == nullptr ? 0 : after->prefix();
+  uint64_t hi = curMin == nullptr ? UINT64_MAX : curMin->prefix();
+
+  for ( uint64_t i = 0; i < size; ) {
+    size_t n;
+    const char * rs =
+      rio_->next_records( min( size - i, KeyFilter::BATCH ), n );
+    if ( rs == nullptr ) {
+      eof_ = true;
+      return i;
+    }
+
+    size_t z = KeyFilter::filter( rs, n, lo, hi, idx );
+    for ( size_t j = 0; j < z; j++ ) {
+      const uint8_t * r = (const uint8_t *) rs + idx[j] * Rec::SIZE;
+      RecordIdx ri( r, fileNo_, loc_ + idx[j] );
+      if ( ri.prefix() == lo or ri.prefix() == hi ) {
+        if ( ( after != nullptr and ri <= *after ) or
+             ( curMin != nullptr and ri >= *curMin ) ) {
+          continue;
+        }
       }
+      r1[i++] = ri;
     }
+    loc_ += n;
   }
   return size;
 }
+
+void RecLoader::gather( const pair<uint64_t, uint64_t> * first,
+                        const pair<uint64_t, uint64_t> * last, char * out )
+{
+  rewind();
+  while ( true ) {
+    size_t n;
+    const char * rs = rio_->next_records( KeyFilter::BATCH, n );
+    if ( rs == nullptr ) {
+      // we must drain the reader to EOF even once we've found everything
+      eof_ = true;
+      break;
+    }
+    for ( ; first != last and first->first < loc_ + n; first++ ) {
+      memcpy( out + first->second * Rec::SIZE,
+              rs + ( first->first - loc_ ) * Rec::SIZE, Rec::SIZE );
+    }
+    loc_ += n;
+  }
+}
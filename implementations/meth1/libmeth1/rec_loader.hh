@@ -3,6 +3,8 @@
 
 #include <memory>
 #include <string>
+#include <system_error>
+#include <utility>
 
 #include "tune_knobs.hh"
 
@@ -22,14 +24,22 @@ private:
   std::unique_ptr<RecIO> rio_;
   bool eof_;
   uint64_t loc_;
+  uint64_t fileNo_;
 
 public:
-  RecLoader( std::string fileName, int flags, bool odirect )
+  RecLoader( std::string fileName, int flags, bool odirect,
+             uint64_t fileNo = 0 )
     : file_{new File( fileName, flags, odirect ? File::DIRECT : File::CACHED )}
     , rio_{new RecIO( *file_, Knobs::DISK_BLOCKS )}
     , eof_{false}
     , loc_{0}
-  {}
+    , fileNo_{fileNo}
+  {
+    if ( Knobs::INDEX_SORT and ( fileNo_ > RecordIdx::FILE_MAX
+                                 or records() > RecordIdx::REC_MAX ) ) {
+      throw std::runtime_error( "Too many files or records for RecordIdx" );
+    }
+  }
 
   /* no copy */
   RecLoader( const RecLoader & ) = delete;
@@ -41,6 +51,7 @@ public:
     , rio_{std::move( other.rio_ )}
     , eof_{other.eof_}
     , loc_{other.loc_}
+    , fileNo_{other.fileNo_}
   {}
 
   RecLoader & operator=( RecLoader && other )
@@ -50,18 +61,31 @@ public:
       rio_ = std::move( other.rio_ );
       eof_ = other.eof_;
       loc_ = other.loc_;
+      fileNo_ = other.fileNo_;
     }
     return *this;
   }
 
   int id( void ) const noexcept { return file_->fd_num(); }
   uint64_t records( void ) const noexcept { return file_->size() / Rec::SIZE; }
+  uint64_t file_no( void ) const noexcept { return fileNo_; }
   bool eof( void ) const noexcept { return eof_; }
   void rewind( void );
 
   RecordPtr next_record( void );
   uint64_t filter( RR * r1, uint64_t size, const Record & after,
                    const RR * const curMin );
+
+  /* Filter into (key, location) tuples. A null `after` means no lower bound,
+   * so every record is a candidate. */
+  uint64_t filter( RecordIdx * r1, uint64_t size, const RecordIdx * after,
+                   const RecordIdx * const curMin );
+
+  /* Copy the records at the given (record number, rank) pairs, sorted by
+   * record number, to `out + rank * Rec::SIZE`. Takes a full pass of the
+   * file. */
+  void gather( const std::pair<uint64_t, uint64_t> * first,
+               const std::pair<uint64_t, uint64_t> * last, char * out );
 };
 
 #endif /* REC_LOADER_HH */
@@ -127,26 +127,19 @@ public:
   }
 };
 
-/* Pointer wrapper around a RemoteFile. */
-class RemoteFilePtr
+/* Merge key for a RemoteFile's current record. We cache the key prefix, so
+ * most comparisons in the merge don't touch the receive buffers. */
+struct RemoteKey
 {
-private:
-  RemoteFile * rf_;
-
-public:
-  explicit RemoteFilePtr( RemoteFile * rf )
-    : rf_{rf}
-  {}
-
-  RemoteFile * rf( void ) const noexcept { return rf_; }
+  uint64_t pfx;
+  RecordPtr rec;
 
-  RecordPtr curRecord( void ) const noexcept { return rf_->curRecord(); }
-  void nextRecord( void ) { return rf_->nextRecord(); }
-  bool eof( void ) const noexcept { return rf_->eof(); }
+  RemoteKey( void ) noexcept : pfx{0}, rec{(const char *) nullptr} {}
+  explicit RemoteKey( RecordPtr r ) noexcept : pfx{r.prefix()}, rec{r} {}
 
-  bool operator>( const RemoteFilePtr & b ) const noexcept
+  bool operator<( const RemoteKey & b ) const noexcept
   {
-    return *rf_ > *b.rf_;
+    return pfx != b.pfx ? pfx < b.pfx : rec < b.rec;
   }
 };
 }
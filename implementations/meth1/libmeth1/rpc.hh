@@ -3,6 +3,8 @@
 
 #include <cstdint>
 
+#include "record.hh"
+
 namespace meth1
 {
 
@@ -10,7 +12,20 @@ enum RPC : int8_t {
   READ,
   SIZE,
   MAX_CHUNK,
-  EXIT
+  EXIT,
+  HISTOGRAM,
+  READ_RANGES
+};
+
+/* A ReadMany key range: every key starting with the first `len` bytes of
+ * `key` (the rest are zero). The node answers with the count of the range's
+ * records by their next key byte if `split`, else with its records in the
+ * range -- just one of them for a whole key, as they are then all equal. */
+struct KeyRange
+{
+  uint8_t key[Rec::KEY_LEN];
+  uint8_t len;
+  uint8_t split;
 };
 
 }
@@ -4,6 +4,9 @@
 #include <cstdint>
 #include <string>
 
+/* Bucket ID on the wire for a node's key sample, sent before any blocks */
+static constexpr uint16_t SAMPLE_BUCKET = 65535;
+
 /* Our block type used through-out method 4 */
 class block_t
 {
@@ -24,6 +27,8 @@ public:
   block_t( const block_t & other )
     : buf{other.buf}, len{other.len}, bucket{other.bucket}
   {}
+
+  block_t & operator=( const block_t & other ) = default;
 };
 
 #endif /* METH4_BLOCK_HH */
@@ -1,7 +1,11 @@
+#include <unistd.h>
+
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <vector>
 
+#include "exception.hh"
 #include "file.hh"
 #include "util.hh"
 
@@ -93,7 +97,8 @@ ClusterMap::ClusterMap( size_t myID, string configFile,
   , bucketsPerNode_{bucketsPerNode( recordsLocally_, disks_ )}
   , bucketMaxSize_{calcMaxSortSize( disks_ )}
   , shards_{calculateShards( bucketsPerNode_ * backends_.size() )}
-  , preShards_{precomputeFirstByte( shards_ )}
+  , splits_{}
+  , prefixLo_{}
   , myBuckets_{calcMyBuckets( myID, backends_.size(), disks_,
                              bucketsPerNode_ * backends_.size() )}
   , myBktSizes_(myBuckets_.size(), 0)
@@ -105,6 +110,78 @@ ClusterMap::ClusterMap( size_t myID, string configFile,
   } else if ( bucketsPerNode_ % disks_ != 0 ) {
     throw runtime_error( "Number of buckets doesn't map to number of disks" );
   }
+  buildLookup();
+}
+
+string ClusterMap::sampleKeys( void ) const
+{
+  // The cluster samples SAMPLE_OVERSAMPLE keys per bucket, however large the
+  // input, so we take our share of that, split between our files by size.
+  // Each file is read in a few short blocks spread evenly through it, taking
+  // a run of keys from each, rather than seeking to each sampled record.
+  constexpr size_t ALIGN = IODevice::ODIRECT_ALIGN;
+  constexpr size_t BLOCK = Knobs4::SAMPLE_BLOCK;
+  static_assert( BLOCK % ALIGN == 0,
+    "SAMPLE_BLOCK not a multiple of O_DIRECT alignment" );
+
+  char * buf = nullptr;
+  if ( posix_memalign( (void **) &buf, ALIGN, BLOCK ) != 0 ) {
+    throw bad_alloc();
+  }
+
+  const uint64_t total = Knobs4::SAMPLE_OVERSAMPLE * bucketsPerNode_;
+  const uint64_t bytes = recordsLocally_ * Rec::SIZE;
+
+  string keys;
+  try {
+    for ( const auto & f : recFiles_ ) {
+      uint64_t fsize = f.size();
+      if ( fsize < Rec::SIZE ) {
+        continue;
+      }
+      uint64_t want = ceil( double( total ) * fsize / bytes );
+      uint64_t blocks = ceil( double( want * Rec::SIZE ) / BLOCK );
+      blocks = max( blocks, uint64_t( Knobs4::SAMPLE_MIN_BLOCKS ) );
+      blocks = min( blocks, want );
+      uint64_t per = ( want + blocks - 1 ) / blocks;
+
+      // one extra record, as the first may straddle the start of the read
+      uint64_t len = ( per + 1 ) * Rec::SIZE;
+      len = min( ( len + ALIGN - 1 ) / ALIGN * ALIGN, uint64_t( BLOCK ) );
+      blocks = max( min( blocks, fsize / len ), uint64_t( 1 ) );
+      uint64_t stride = fsize / blocks;
+
+      for ( uint64_t b = 0; b < blocks; b++ ) {
+        uint64_t off = b * stride;
+        off -= off % ALIGN;
+        size_t n = SystemCall( "pread",
+          ::pread( f.fd_num(), buf, len, off ) );
+
+        // only whole records, starting at the first boundary in the block
+        uint64_t r = ( off + Rec::SIZE - 1 ) / Rec::SIZE * Rec::SIZE;
+        for ( uint64_t i = 0; i < per and r + Rec::SIZE <= off + n;
+              i++, r += Rec::SIZE ) {
+          keys.append( buf + ( r - off ), Rec::KEY_LEN );
+        }
+      }
+    }
+  } catch ( ... ) {
+    free( buf );
+    throw;
+  }
+  free( buf );
+
+  return keys;
+}
+
+void ClusterMap::setSplitters( const string & sample )
+{
+  if ( sample.size() / Rec::KEY_LEN < buckets() ) {
+    // too few keys to say anything, so stay with equal-width ranges
+    return;
+  }
+  shards_ = quantileShards( sample );
+  buildLookup();
 }
 
 uint16_t ClusterMap::myID( void ) const noexcept
@@ -243,21 +320,57 @@ ClusterMap::shards_t ClusterMap::calculateShards( size_t buckets )
 
   return shards;
 }
-ClusterMap::pre_shards_t ClusterMap::precomputeFirstByte( shards_t shards )
-  const noexcept
+
+/* Bucket i takes keys up to the (i+1)/buckets quantile of the sample. */
+ClusterMap::shards_t ClusterMap::quantileShards( const string & sample ) const
 {
-  pre_shards_t preShards( 256 );
-  uint16_t lastb0 = 0;
+  size_t n = sample.size() / Rec::KEY_LEN;
+  size_t buckets = shards_.size();
 
-  for ( auto & s : shards ) {
-    uint16_t b0 = s.k_[0];
-    for ( uint16_t bi = lastb0; bi <= b0; bi++ ) {
-      preShards[bi].push_back( s );
-    }
-    lastb0 = b0;
+  vector<const uint8_t *> keys;
+  keys.reserve( n );
+  for ( size_t i = 0; i < n; i++ ) {
+    keys.push_back( (const uint8_t *) sample.data() + i * Rec::KEY_LEN );
+  }
+  sort( keys.begin(), keys.end(), []( const uint8_t * a, const uint8_t * b ) {
+    return key_compare( a, b ) < 0;
+  } );
+
+  shards_t shards;
+  for ( size_t i = 0; i < buckets - 1; i++ ) {
+    shard_t s( i );
+    memcpy( s.k_, keys[( i + 1 ) * n / buckets - 1], Rec::KEY_LEN );
+    shards.push_back( s );
   }
 
-  return preShards;
+  // final one always covers the rest of the key space
+  shards.push_back( shards_.back() );
+
+  return shards;
+}
+
+ClusterMap::key_int_t ClusterMap::key_int( const uint8_t * key ) noexcept
+{
+  return key_int_t( Rec::key_prefix( key ) ) << 16 | Rec::key_tail( key );
+}
+
+void ClusterMap::buildLookup( void )
+{
+  splits_.clear();
+  for ( auto & s : shards_ ) {
+    splits_.push_back( key_int( s.k_ ) );
+  }
+
+  // the last shard always ends at the max key, so clamping to it is safe
+  prefixLo_.resize( ( size_t( 1 ) << PREFIX_BITS ) + 1 );
+  size_t s = 0;
+  for ( size_t p = 0; p < prefixLo_.size(); p++ ) {
+    while ( s < splits_.size() and
+            splits_[s] >> ( KEY_BITS - PREFIX_BITS ) < p ) {
+      s++;
+    }
+    prefixLo_[p] = min( s, splits_.size() - 1 );
+  }
 }
 
 vector<uint16_t> ClusterMap::calcMyBuckets( uint16_t id, size_t nodes,
@@ -275,17 +388,33 @@ vector<uint16_t> ClusterMap::calcMyBuckets( uint16_t id, size_t nodes,
   return myBuckets;
 }
 
+/* First shard with a key >= `key`. */
+inline uint16_t ClusterMap::lookup( key_int_t key ) const noexcept
+{
+  size_t p = key >> ( KEY_BITS - PREFIX_BITS );
+  const key_int_t * base = splits_.data() + prefixLo_[p];
+  size_t n = prefixLo_[p + 1] - prefixLo_[p] + 1;
+
+  // branchless lower bound -- the last candidate is always >= key
+  while ( n > 1 ) {
+    size_t half = n / 2;
+    base = base[half - 1] < key ? base + half : base;
+    n -= half;
+  }
+  return base - splits_.data();
+}
+
 uint16_t ClusterMap::bucket( const uint8_t * key ) const noexcept
 {
-  size_t b;
-  // shards_t & shards = shards_;
-  const shards_t & shards = preShards_[key[0]];
-  for ( b = 0; b < shards.size() - 1; b++ ) {
-    if ( memcmp( key, shards[b].k_, Rec::KEY_LEN ) <= 0 ) {
-      break;
-    }
+  return lookup( key_int( key ) );
+}
+
+void ClusterMap::bucket( const char * recs, size_t n, uint16_t * out )
+  const noexcept
+{
+  for ( size_t i = 0; i < n; i++ ) {
+    out[i] = lookup( key_int( (const uint8_t *) recs + i * Rec::SIZE ) );
   }
-  return shards[b].id_;
 }
 
 uint64_t ClusterMap::bucketSize( uint16_t bkt ) const noexcept
@@ -2,6 +2,7 @@
 #define METH4_CLUSTER_MAP_HH
 
 #include <string>
+#include <vector>
 
 #include "address.hh"
 #include "file.hh"
@@ -25,7 +26,11 @@ private:
   };
 
   using shards_t = std::vector<shard_t>;
-  using pre_shards_t = std::vector<shards_t>;
+
+  /* A key as a big-endian 80 bit integer */
+  using key_int_t = __uint128_t;
+  static constexpr size_t KEY_BITS = Rec::KEY_LEN * 8;
+  static constexpr size_t PREFIX_BITS = 16;
 
   /* cluster config */
   size_t myID_;
@@ -41,7 +46,13 @@ private:
 
   /* actual cached bucket mapping */
   shards_t shards_;
-  pre_shards_t preShards_;
+
+  /* Bucket lookup: shard keys as integers, and for each 16 bit key prefix the
+   * first shard that a key with that prefix can map to. The last candidate
+   * for a prefix is the first shard of the next prefix, which leaves a short
+   * (usually empty) range to binary search. */
+  std::vector<key_int_t> splits_;
+  std::vector<uint16_t> prefixLo_;
 
   /* bucket to local node mapping */
   std::vector<uint16_t> myBuckets_;
@@ -49,7 +60,10 @@ private:
 
   /* helper functions */
   shards_t calculateShards( size_t buckets ) const noexcept;
-  pre_shards_t precomputeFirstByte( shards_t shards ) const noexcept;
+  shards_t quantileShards( const std::string & sample ) const;
+  void buildLookup( void );
+  static key_int_t key_int( const uint8_t * key ) noexcept;
+  uint16_t lookup( key_int_t key ) const noexcept;
   std::vector<uint16_t> calcMyBuckets( uint16_t id, size_t nodes, size_t disks,
                                        size_t buckets ) const noexcept;
 
@@ -57,6 +71,13 @@ public:
   ClusterMap( size_t myID, std::string configFile,
     std::vector<std::string> dataFiles );
 
+  /* Sample keys from our record files, packed as an array of keys. */
+  std::string sampleKeys( void ) const;
+
+  /* Replace the equal-width key ranges of each bucket with quantiles of the
+   * cluster-wide key sample. Every node must be given the same sample. */
+  void setSplitters( const std::string & sample );
+
   /* My ID (and position in vector) in the cluster. */
   uint16_t myID( void ) const noexcept;
 
@@ -106,6 +127,9 @@ public:
   /* Map a key to a bucket. */
   uint16_t bucket( const uint8_t * key ) const noexcept;
 
+  /* Map each of `n` contiguous records to its bucket, in `out` (size >= n). */
+  void bucket( const char * recs, size_t n, uint16_t * out ) const noexcept;
+
   /* Maximum bucket size in bytes. */
   size_t bucketMaxSize( void ) const noexcept;
 
@@ -10,27 +10,34 @@
 
 /*
  * Queue Lengths:
- * A) (QL + 2) x #Disks.
- * B) (QL + 1 ) x #Disks + #NodeBuckets.
+ * A) #Workers x #Disks read blocks.
+ * B) (QL + 1 ) x #Disks + #Nodes.
  * C) QL + 1 + #ClusterBuckets x #Disks.
  *
  * Buffer Sizes (now):
- * A) 2GB x #Disks.
- * B) 2GB x #Disks + #NodeBuckets x 10MB.
+ * A) #Disks x #Workers x ( 10MB + #ClusterBuckets x 12.5KB ).
+ * B) 2GB x #Disks + #Nodes x 10MB.
  * C) 4GB + #ClusterBuckets x #Disks x 1MB.
  *
  * Total Size (now):
  * T = A + B + C
- * T = 4GB + #NodeBuckets x 10MB + #Disks x ( 4GB + #ClusterBuckets x 1MB )
+ * T ~ 4GB + #Nodes x 10MB + #Disks x ( 2GB + #ClusterBuckets x 1MB )
  */
 
 namespace Knobs4 {
-  /* A. Disk read queue length */
-  static constexpr uint64_t DISK_R_QUEUE_LENGTH = 200; // ~ 2000MB
+  /* A. Partitioning threads per input file, the block of the file each
+   * claims in turn [* Rec::SIZE], and each thread's own buffer per bucket
+   * [* Rec::SIZE], merged into the bucket's network block when full. The
+   * read block must keep O_DIRECT alignment. Records reach a thread's bucket
+   * buffer through a cache resident stage of PARTITION_STAGE records, which
+   * must divide PARTITION_BUF and be a multiple of 16 bytes. */
+  static constexpr size_t PARTITION_WORKERS = 4;
+  static constexpr size_t PARTITION_READ_BLOCK = 1024 * 100; // ~ 10MB
+  static constexpr size_t PARTITION_BUF = 128; // ~ 12.5KB
+  static constexpr size_t PARTITION_STAGE = 4; // 400B
 
-  /* B. Disk block size (writing) [* Rec::SIZE] */
+  /* B. Disk write queue length (blocks are as received, ~ NET_BLOCK_SIZE) */
   static constexpr size_t DISK_W_QUEUE_LENGTH = 200; // ~ 2000MB
-  static constexpr size_t DISK_W_BLOCK_SIZE = 1024 * 102; // ~ 10MB
 
   /* C. Network queue length & block transfer size [* Rec::SIZE] */
   static constexpr size_t NET_QUEUE_LENGTH = 2000; // ~ 4000MB
@@ -43,6 +50,23 @@ namespace Knobs4 {
   /* Use non-blocking IO on the phase-1 receive side? */
   static constexpr bool NET_NON_BLOCKING = true;
 
+  /* Send phase-1 blocks from one thread polling non-blocking sockets, always
+   * writing to whichever node can take data (rather than a blocking thread
+   * per node)? */
+  static constexpr bool NET_SEND_POLL = true;
+
+  /* Choose bucket boundaries from a sample of keys exchanged between all
+   * nodes (rather than splitting the key space evenly), so buckets stay
+   * balanced on skewed input? The cluster samples SAMPLE_OVERSAMPLE keys per
+   * bucket (so the exchange doesn't grow with the input), each node taking
+   * its share in runs of keys from reads of at most SAMPLE_BLOCK bytes spread
+   * evenly through each file -- at least SAMPLE_MIN_BLOCKS of them, as
+   * neighbouring records can have similar keys. */
+  static constexpr bool SAMPLE_SPLITTERS = true;
+  static constexpr size_t SAMPLE_OVERSAMPLE = 1000;
+  static constexpr size_t SAMPLE_BLOCK = 64 * 1024;
+  static constexpr size_t SAMPLE_MIN_BLOCKS = 256;
+
   /* Minimum number of buckets to have per disk */
   static constexpr size_t MIN_BUCKETS_PER_DISK = 2;
 
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <chrono>
+#include <future>
 #include <memory>
 #include <vector>
 #include <utility>
@@ -53,6 +54,25 @@ void debug_cluster_map( ClusterMap & cluster )
   print( "client", cluster.client().to_string() );
 }
 
+// Agree on bucket boundaries from a sample of every node's keys.
+void exchange_sample( ClusterMap & cluster, NetOut & net, Receiver & receiver )
+{
+  auto t0 = time_now();
+  string keys = cluster.sampleKeys();
+
+  // send from a separate thread, so we can't deadlock with a node that's
+  // also sending before receiving
+  auto sent = async( launch::async, [&net, &keys]() {
+    net.sendSample( keys );
+  } );
+  string all = receiver.recvSamples();
+  sent.get();
+
+  cluster.setSplitters( all );
+  print( "p0", "sample", keys.size() / Rec::KEY_LEN,
+    all.size() / Rec::KEY_LEN, time_diff<ms>( t0 ) );
+}
+
 // Do in seperate block as we want destructors to run to free memory after
 // phase one is complete.
 void phase_one( ClusterMap & cluster, string port )
@@ -69,6 +89,11 @@ void phase_one( ClusterMap & cluster, string port )
   // establish inbound connections
   receiver.waitForConnections();
 
+  // pick bucket boundaries before any records are sent
+  if ( Knobs4::SAMPLE_SPLITTERS ) {
+    exchange_sample( cluster, net, receiver );
+  }
+
   // transfer data to correct nodes
   vector<unique_ptr<Sender>> senders;
   for ( auto & f : cluster.files() ) {
@@ -9,9 +9,9 @@ using namespace std;
 using namespace PollerShortNames;
 
 // Allocation helper
-static uint8_t * newBlock( void )
+static uint8_t * newBlock( size_t len )
 {
-  return (uint8_t *) malloc( Receiver::DISK_BLOCK_SIZE );
+  return (uint8_t *) malloc( len );
 }
 
 // De-allocation helper
@@ -30,8 +30,8 @@ NetIn::NetIn( ClusterMap & cluster, vector<DiskWriter> & disks, TCPSocket sock )
   , header_{}
   , headerOnWire_{0}
   , bucketOnWire_{0}
-  , bucketLocalID_{0}
   , bodyOnWire_{0}
+  , body_{}
   , cantMove_{false}
 {
 }
@@ -44,8 +44,8 @@ NetIn::NetIn( NetIn && other )
   , wireState_{other.wireState_}
   , headerOnWire_{other.headerOnWire_}
   , bucketOnWire_{other.bucketOnWire_}
-  , bucketLocalID_{other.bucketLocalID_}
   , bodyOnWire_{other.bodyOnWire_}
+  , body_{other.body_}
   , cantMove_{other.cantMove_}
 {
   if ( other.cantMove_  ) {
@@ -59,13 +59,18 @@ NetIn::NetIn( NetIn && other )
   other.wireState_ = DONE;
   other.headerOnWire_ = 0;
   other.bodyOnWire_ = 0;
+  other.body_ = {};
 }
 
-bool NetIn::read( std::vector<block_t> & buckets )
+NetIn::~NetIn( void )
 {
-  size_t n, rmax, offset;
+  freeBlock( body_.buf );
+}
+
+bool NetIn::read( void )
+{
+  size_t n, offset;
   const uint8_t * rpcData = header_; // work-around strict-aliasing rules
-  block_t * block;
 
   while ( true ) {
     switch ( wireState_ )
@@ -92,7 +97,6 @@ bool NetIn::read( std::vector<block_t> & buckets )
     case PARSE:
       bucketOnWire_ = *reinterpret_cast<const uint16_t *>( rpcData );
       bodyOnWire_ = *reinterpret_cast<const uint64_t *>( rpcData + 2 );
-      bucketLocalID_ = cluster_.bucket_local_id( bucketOnWire_  );
       if ( bodyOnWire_ == 0 ) { // EOF -- bucket
         bucketsLive_--;
         if ( bucketsLive_ == 0 ) {
@@ -104,32 +108,26 @@ bool NetIn::read( std::vector<block_t> & buckets )
         }
       }
       cluster_.bucketSize( bucketOnWire_ ) += bodyOnWire_ / Rec::SIZE;
+      body_ = {newBlock( bodyOnWire_ ), 0, bucketOnWire_};
       wireState_ = BODY;
 
     case BODY:
       if ( bodyOnWire_ == 0 ) {
         throw runtime_error( "No header to read from wire" );
       }
-      block = &buckets[bucketLocalID_];
-      if ( block->bucket != bucketOnWire_ ) {
-        throw runtime_error( "Wrong bucket selected" );
-      }
-      rmax = min( Receiver::DISK_BLOCK_SIZE - block->len, bodyOnWire_ );
-      n = sock_.read( (char *) block->buf + block->len, rmax );
+      n = sock_.read( (char *) body_.buf + body_.len, bodyOnWire_ );
       if ( n == 0 ) {
         return true;
       }
-      block->len += n;
+      body_.len += n;
       bodyOnWire_ -= n;
 
-      if ( block->len == Receiver::DISK_BLOCK_SIZE or bodyOnWire_ == 0 ) {
+      // only whole bodies go to disk, so records are never interleaved
+      if ( bodyOnWire_ == 0 ) {
         DiskWriter & dw = disks_[cluster_.bucket_disk( bucketOnWire_ )];
-        dw.send( *block );
-        block->buf = newBlock();
-        block->len = 0;
-        if ( bodyOnWire_ == 0 ) {
-          wireState_ = IDLE;
-        }
+        dw.send( body_ );
+        body_ = {};
+        wireState_ = IDLE;
       }
       break;
 
@@ -149,7 +147,6 @@ Receiver::Receiver( ClusterMap & cluster, Address address )
   , poll_{}
   , sock_{IPV4}
   , netins_{}
-  , buckets_{cluster.myBuckets().size()}
   , backendsLive_{cluster_.nodes()}
   , disks_{}
 {
@@ -162,10 +159,6 @@ Receiver::Receiver( ClusterMap & cluster, Address address )
 
   print( "p0", "listen", sock_.local_address().to_string() );
 
-  for ( size_t i = 0; i < buckets_.size(); i++ ) {
-    buckets_[i] = {newBlock(), 0, cluster_.myBuckets()[i]};
-  }
-
   // FIXME: Hacky that we don't really allow moving, so can't have the vector
   // be resized.
   disks_.reserve( cluster_.disk_paths().size() );
@@ -175,13 +168,6 @@ Receiver::Receiver( ClusterMap & cluster, Address address )
   }
 }
 
-Receiver::~Receiver( void )
-{
-  for ( auto & b : buckets_ ) {
-    freeBlock( b.buf );
-  }
-}
-
 void Receiver::waitForConnections( void )
 {
   for ( size_t i = 0; i < cluster_.nodes(); i++ ) {
@@ -189,9 +175,6 @@ void Receiver::waitForConnections( void )
     s.set_nodelay();
     s.set_send_buffer( Knobs4::NET_SND_BUF );
     s.set_recv_buffer( Knobs4::NET_RCV_BUF );
-    if ( NET_NON_BLOCKING ) {
-      s.set_non_blocking();
-    }
     netins_.emplace_back( cluster_, disks_, move( s ) );
     print( "p0", "new-connection",
       netins_.back().socket().peer_address().to_string() );
@@ -201,7 +184,7 @@ void Receiver::waitForConnections( void )
   for ( auto & n : netins_ ) {
     n.disableMove();
     poll_.add_action({ n.socket(), Direction::In, [&n, this]() {
-      bool alive = n.read( buckets_ );
+      bool alive = n.read();
       if ( not alive ) {
         backendsLive_--;
         if ( backendsLive_ == 0 ) {
@@ -216,8 +199,35 @@ void Receiver::waitForConnections( void )
   }
 }
 
+/* Receive the key sample sent by every node (including us), concatenated. */
+string Receiver::recvSamples( void )
+{
+  string keys;
+  for ( auto & n : netins_ ) {
+    char header[NetIn::HDRSIZE];
+    const char * rpcData = header; // avoids breaking strict aliasing rules
+    n.socket().read_all( header, NetIn::HDRSIZE );
+    uint16_t bkt = *reinterpret_cast<const uint16_t *>( rpcData );
+    uint64_t len = *reinterpret_cast<const uint64_t *>( rpcData + 2 );
+    if ( n.socket().eof() or bkt != SAMPLE_BUCKET ) {
+      throw runtime_error( "Expected key sample from node" );
+    }
+    if ( len > 0 ) {
+      keys += n.socket().read_all( len );
+    }
+  }
+  return keys;
+}
+
 void Receiver::receiveLoop( void )
 {
+  // blocking until now, for the sample exchange
+  if ( NET_NON_BLOCKING ) {
+    for ( auto & n : netins_ ) {
+      n.socket().set_non_blocking();
+    }
+  }
+
   auto t0 = time_now();
   print( "p1", "recv-start", timestamp<ms>() );
   poll_.loop();
@@ -1,6 +1,7 @@
 #ifndef METH4_RECV_HH
 #define METH4_RECV_HH
 
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -17,10 +18,11 @@
  * for all buckets. */
 class NetIn
 {
-private:
+public:
   /* RPC Format: <uint16_t, uint64_t> = <bucket_id, rpc_size> */
   static constexpr size_t HDRSIZE = sizeof( uint16_t ) + sizeof( uint64_t );
 
+private:
   /* FSM for the connection with a backend */
   enum wire_state_t { IDLE, HEADER, PARSE, BODY, DONE };
 
@@ -33,9 +35,12 @@ private:
   uint8_t header_[HDRSIZE];
   size_t headerOnWire_;
   uint16_t bucketOnWire_;
-  size_t bucketLocalID_;
   size_t bodyOnWire_;
 
+  /* body being received -- our own, as a read can end mid-record and other
+   * nodes send to the same buckets */
+  block_t body_;
+
   bool cantMove_;
 
 public:
@@ -48,37 +53,32 @@ public:
   /* disable copy */
   NetIn( const NetIn & ) = delete;
 
+  ~NetIn( void );
+
   /* Hack: we disable the ability to move, called once we take a reference. */
   void disableMove( void ) noexcept { cantMove_ = true; }
 
   TCPSocket & socket( void ) noexcept { return sock_; }
 
   /* bool indicates if NetIn is still active */
-  bool read( std::vector<block_t> & buckets );
+  bool read( void );
 };
 
 class Receiver
 {
 public:
   static constexpr bool NET_NON_BLOCKING = Knobs4::NET_NON_BLOCKING;
-  static constexpr size_t DISK_BLOCK_SIZE =
-    Knobs4::DISK_W_BLOCK_SIZE * Rec::SIZE;
-
-  static_assert( DISK_BLOCK_SIZE % Rec::SIZE == 0,
-    "DISK_BLOCK_SIZE not a multiple of Rec::SIZE");
 
 private:
   ClusterMap & cluster_;
   Poller poll_;
   TCPSocket sock_;
   std::vector<NetIn> netins_;
-  std::vector<block_t> buckets_;
   size_t backendsLive_;
   std::vector<DiskWriter> disks_;
 
 public:
   Receiver( ClusterMap & cluster, Address address );
-  ~Receiver( void );
 
   /* Disable copy & move */
   Receiver( const Receiver & ) = delete;
@@ -88,6 +88,7 @@ public:
 
   /* Handle the network receive side */
   void waitForConnections( void );
+  std::string recvSamples( void );
   void receiveLoop( void );
   void waitFinished( void );
 };
@@ -1,9 +1,20 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#include "exception.hh"
+#include "poller.hh"
 #include "sync_print.hh"
 
 #include "meth4_knobs.hh"
 #include "send.hh"
 
 using namespace std;
+using namespace PollerShortNames;
 
 // Allocation helper
 static uint8_t * newBlock( void )
@@ -25,10 +36,11 @@ static void freeBlock( uint8_t * buf )
 NetOut::NetOut( ClusterMap & cluster )
   : sockets_{}
   , cluster_{cluster}
-  , queue_{NET_QUEUE_LENGTH}
+  , queues_{}
   , netsend_{}
+  , out_{}
+  , wake_{Pipe::NewPair()}
 {
-  // PERF: May need multiple threads here to saturate network
   for ( const auto & c : cluster_.addresses() ) {
     TCPSocket sock{(IPVersion) c.domain()};
     sock.set_nodelay();
@@ -39,24 +51,49 @@ NetOut::NetOut( ClusterMap & cluster )
     sockets_.push_back( move( sock ) );
   }
 
-  netsend_ = thread( &NetOut::sendLoop, this );
+  // a queue per node, so a slow receiver doesn't hold up the rest
+  size_t qlen = max( NET_QUEUE_LENGTH / sockets_.size(), size_t( 1 ) );
+  for ( size_t i = 0; i < sockets_.size(); i++ ) {
+    queues_.push_back( Channel<block_t>{qlen} );
+  }
+
+  if ( NET_SEND_POLL ) {
+    out_.resize( sockets_.size() );
+    netsend_.push_back( thread( &NetOut::pollLoop, this ) );
+  } else {
+    for ( size_t i = 0; i < sockets_.size(); i++ ) {
+      netsend_.push_back( thread( &NetOut::sendLoop, this, i ) );
+    }
+  }
 }
 
 NetOut::~NetOut( void )
 {
-  queue_.waitEmpty();
-  queue_.close();
-  if ( netsend_.joinable() ) { netsend_.join(); }
+  for ( auto & q : queues_ ) {
+    q.waitEmpty();
+    q.close();
+  }
+  if ( NET_SEND_POLL ) {
+    // in case the poller is still waiting for its first block
+    SystemCall( "write", ::write( wake_.second.fd_num(), "", 1 ) );
+  }
+  for ( auto & t : netsend_ ) {
+    if ( t.joinable() ) { t.join(); }
+  }
 }
 
-void sendRPCHeader( TCPSocket & sock, uint16_t bkt, size_t len )
+static void fillRPCHeader( char * header, uint16_t bkt, size_t len )
 {
-  constexpr size_t HDRSIZE = sizeof( uint16_t ) + sizeof( uint64_t );
-  char header[HDRSIZE];
   char * rpcData = header; // avoids breaking strict aliasing rules
   *reinterpret_cast<uint16_t *>( rpcData ) = bkt;
   *reinterpret_cast<uint64_t *>( rpcData + 2 ) = len;
-  sock.write_all( header, HDRSIZE );
+}
+
+void sendRPCHeader( TCPSocket & sock, uint16_t bkt, size_t len )
+{
+  char header[NetOut::HDRSIZE];
+  fillRPCHeader( header, bkt, len );
+  sock.write_all( header, NetOut::HDRSIZE );
 }
 
 void sendRPCBody( TCPSocket & sock, uint8_t * buf, size_t len )
@@ -64,18 +101,19 @@ void sendRPCBody( TCPSocket & sock, uint8_t * buf, size_t len )
   sock.write_all( (char *) buf, len );
 }
 
-void NetOut::sendLoop( void )
+void NetOut::sendLoop( size_t node )
 {
-  print( "p1", "netout-start", timestamp<ms>() );
+  print( "p1", "netout-start", node, timestamp<ms>() );
   auto t0 = time_now();
   tdiff_t tnet = 0;
 
-  size_t activeBuckets = cluster_.buckets() * cluster_.disks();
+  Channel<block_t> & queue = queues_[node];
+  TCPSocket & sock = sockets_[node];
+  size_t activeBuckets = nodeBuckets( node );
+
   try {
     while ( activeBuckets > 0 ) {
-      block_t block = queue_.recv();
-      size_t nodeID = cluster_.bucket_node( block.bucket );
-      TCPSocket & sock = sockets_[nodeID];
+      block_t block = queue.recv();
 
       // PERF: Overhead of taking this many timestamps?
       auto t1 = time_now();
@@ -83,6 +121,9 @@ void NetOut::sendLoop( void )
         activeBuckets--;
         sendRPCHeader( sock, block.bucket, 0 );
         tnet += time_diff<us>( t1 );
+      } else if ( block.len == 0 ) {
+        // empty drain -- a zero length body would read as EOF
+        freeBlock( block.buf );
       } else {
         // PERF: hopefully we won't block so much here to a individual node as
         // to hurt overall network performance.
@@ -97,24 +138,150 @@ void NetOut::sendLoop( void )
   }
 
   tnet /= 1000;
-  print( "p1", "netout-done", timestamp<ms>(), time_diff<ms>( t0 ), tnet );
+  print( "p1", "netout-done", node, timestamp<ms>(), time_diff<ms>( t0 ),
+    tnet );
+}
+
+// An EOF from each disk's sender for every bucket `node` owns.
+size_t NetOut::nodeBuckets( size_t node ) const
+{
+  size_t n = 0;
+  for ( size_t b = 0; b < cluster_.buckets(); b++ ) {
+    if ( cluster_.bucket_node( b ) == node ) {
+      n += cluster_.disks();
+    }
+  }
+  return n;
+}
+
+// Take the next block for `node` off its queue (if any) to start writing.
+bool NetOut::nextBlock( size_t node )
+{
+  Outgoing & o = out_[node];
+  block_t block;
+  while ( o.active > 0 and queues_[node].try_recv( block ) ) {
+    if ( block.buf != nullptr and block.len == 0 ) {
+      // empty drain -- a zero length body would read as EOF
+      freeBlock( block.buf );
+      continue;
+    }
+    o.block = block;
+    fillRPCHeader( o.header, block.bucket, block.len );
+    o.sent = 0;
+    o.busy = true;
+    return true;
+  }
+  return false;
+}
+
+// Write as much of `node`'s blocks as its socket will take without blocking.
+void NetOut::writeBlock( size_t node )
+{
+  Outgoing & o = out_[node];
+  TCPSocket & sock = sockets_[node];
+
+  while ( o.busy ) {
+    size_t n;
+    if ( o.sent < HDRSIZE ) {
+      n = sock.try_write( o.header + o.sent, HDRSIZE - o.sent );
+    } else {
+      size_t off = o.sent - HDRSIZE;
+      n = sock.try_write( (char *) o.block.buf + off, o.block.len - off );
+    }
+    if ( n == 0 ) {
+      return; // full
+    }
+    o.sent += n;
+
+    if ( o.sent == HDRSIZE + o.block.len ) {
+      if ( o.block.buf == nullptr ) {
+        o.active--;
+      } else {
+        freeBlock( o.block.buf );
+      }
+      o.busy = false;
+      nextBlock( node );
+    }
+  }
+}
+
+void NetOut::pollLoop( void )
+{
+  // blocking until the first block is queued, so sendSample can still write
+  // straight to the sockets
+  char wake[4096];
+  wake_.first.read( wake, 1 );
+  print( "p1", "netout-start", timestamp<ms>() );
+  auto t0 = time_now();
+
+  size_t active = 0;
+  for ( size_t i = 0; i < sockets_.size(); i++ ) {
+    sockets_[i].set_non_blocking();
+    out_[i].active = nodeBuckets( i );
+    active += out_[i].active;
+  }
+
+  Poller poll;
+  for ( size_t i = 0; i < sockets_.size(); i++ ) {
+    poll.add_action( { sockets_[i], Direction::Out, [this, i, &active]() {
+      size_t live = out_[i].active;
+      writeBlock( i );
+      active -= live - out_[i].active;
+      return active == 0 ? ResultType::Exit : ResultType::Continue;
+    }, [this, i]() { return out_[i].busy; } } );
+  }
+
+  // new blocks: start on any node we aren't already writing to
+  poll.add_action( { wake_.first, Direction::In, [this, &wake]() {
+    wake_.first.read( wake, sizeof( wake ) );
+    for ( size_t i = 0; i < sockets_.size(); i++ ) {
+      if ( not out_[i].busy ) {
+        nextBlock( i );
+      }
+    }
+    return ResultType::Continue;
+  } } );
+
+  try {
+    for ( size_t i = 0; i < sockets_.size(); i++ ) {
+      nextBlock( i );
+    }
+    poll.loop();
+  } catch ( const Channel<block_t>::closed_error & e ) {
+    // EOF
+  }
+
+  print( "p1", "netout-done", timestamp<ms>(), time_diff<ms>( t0 ) );
 }
 
 void NetOut::send( block_t block )
 {
-  queue_.send( block );
+  queues_[cluster_.bucket_node( block.bucket )].send( block );
+  if ( NET_SEND_POLL ) {
+    // straight write (not through Pipe) as the senders share it
+    SystemCall( "write", ::write( wake_.second.fd_num(), "", 1 ) );
+  }
+}
+
+void NetOut::sendSample( const string & keys )
+{
+  for ( auto & sock : sockets_ ) {
+    sendRPCHeader( sock, SAMPLE_BUCKET, keys.size() );
+    sendRPCBody( sock, (uint8_t *) keys.data(), keys.size() );
+  }
 }
 
 Sender::Sender( File & file, ClusterMap & cluster, NetOut & net  )
-  : rio_{file, DISK_QUEUE_LENGTH}
+  : file_{file}
   , cluster_{cluster}
   , net_{net}
-  , buckets_{cluster.buckets()}
+  , buckets_( cluster.buckets() )
+  , nextRead_{0}
   , sorter_{}
   , start_{}
 {
   for ( uint16_t i = 0; i < buckets_.size(); i++ ) {
-    buckets_[i] = {newBlock(), 0, i};
+    buckets_[i].block = {newBlock(), 0, i};
   }
 }
 
@@ -124,38 +291,120 @@ Sender::~Sender( void )
   print( "p1", "send-end", timestamp<ms>(), time_diff<ms>( start_ ) );
 }
 
-void Sender::_start( void )
+size_t Sender::readBlock( char * buf, uint64_t blk )
 {
-  auto t0 = time_now();
-  rio_.rewind();
+  // straight pread (not through File) so the workers can share the fd. Only
+  // the file's last block comes back short (and O_DIRECT won't let us retry
+  // from an unaligned offset anyway).
+  size_t n = SystemCall( "pread",
+    ::pread( file_.fd_num(), buf, READ_BLOCK, blk * READ_BLOCK ) );
+  return n - n % Rec::SIZE;
+}
+
+void Sender::merge( uint16_t bkt, const uint8_t * recs, size_t len )
+{
+  Bucket & b = buckets_[bkt];
+  while ( len > 0 ) {
+    // a worker's final flush may be any length, so don't rely on filling the
+    // block exactly
+    unique_lock<mutex> ul( b.lock );
+    size_t n = min( len, NetOut::NET_BLOCK_SIZE - b.block.len );
+    memcpy( b.block.buf + b.block.len, recs, n );
+    b.block.len += n;
+    recs += n;
+    len -= n;
+
+    // send full bucket
+    if ( b.block.len == NetOut::NET_BLOCK_SIZE ) {
+      block_t full = b.block;
+      b.block.buf = newBlock();
+      b.block.len = 0;
+      ul.unlock();
+      net_.send( full );
+    }
+  }
+}
+
+void Sender::partition( void )
+{
+  const size_t nbkts = buckets_.size();
+
+  char * buf = nullptr;
+  if ( posix_memalign( (void **) &buf, IODevice::ODIRECT_ALIGN,
+                       READ_BLOCK ) != 0 ) {
+    throw bad_alloc();
+  }
+  unique_ptr<char, void (*)( void * )> bufGuard( buf, free );
+
+  // our own buffer per bucket, only touched (and so backed by memory) for
+  // the buckets we actually see. Records reach it through a write-combining
+  // stage, as scattering straight to it would miss cache on nearly every
+  // record.
+  uint8_t * local = nullptr;
+  if ( posix_memalign( (void **) &local, Stage::ALIGN,
+                       nbkts * LOCAL_BUF ) != 0 ) {
+    throw bad_alloc();
+  }
+  unique_ptr<uint8_t, void (*)( void * )> localGuard( local, free );
+  Stage stage( nbkts );
+  vector<size_t> used( nbkts );
+  vector<uint16_t> bkts( READ_BLOCK / Rec::SIZE );
 
   while ( true ) {
-    // get next record from disk
-    RecordPtr rec = rio_.next_record();
-    if ( rec.isNull() ) {
+    // claim the next block of the file
+    size_t n = readBlock( buf, nextRead_++ ) / Rec::SIZE;
+    if ( n == 0 ) {
       break;
     }
+    cluster_.bucket( buf, n, bkts.data() );
 
-    // place record into bucket
-    size_t bkt = cluster_.bucket( rec.key() );
-    block_t & bucket = buckets_[bkt];
-    memcpy( bucket.buf + bucket.len, rec.data(), Rec::SIZE );
-    bucket.len += Rec::SIZE;
+    for ( size_t i = 0; i < n; i++ ) {
+      uint16_t b = bkts[i];
+      if ( stage.add( b, (const uint8_t *) buf + i * Rec::SIZE ) ) {
+        uint8_t * lbuf = local + b * LOCAL_BUF;
+        used[b] += stage.flush( b, lbuf + used[b] );
+        if ( used[b] == LOCAL_BUF ) {
+          Stage::fence();
+          merge( b, lbuf, LOCAL_BUF );
+          used[b] = 0;
+        }
+      }
+    }
+  }
 
-    // send full bucket
-    if ( bucket.len == NetOut::NET_BLOCK_SIZE ) {
-      net_.send( bucket );
-      bucket.buf = newBlock();
-      bucket.len = 0;
+  // hand over what's left
+  for ( size_t b = 0; b < nbkts; b++ ) {
+    uint8_t * lbuf = local + b * LOCAL_BUF;
+    used[b] += stage.flush( b, lbuf + used[b] );
+    if ( used[b] > 0 ) {
+      Stage::fence();
+      merge( b, lbuf, used[b] );
     }
   }
+}
+
+void Sender::_start( void )
+{
+  auto t0 = time_now();
+  nextRead_ = 0;
+
+  vector<thread> workers;
+  for ( size_t i = 0; i < WORKERS; i++ ) {
+    workers.push_back( thread( &Sender::partition, this ) );
+  }
+  for ( auto & w : workers ) {
+    w.join();
+  }
 
   // drain all buckets
-  for ( auto & bkt : buckets_ ) {
+  for ( auto & b : buckets_ ) {
+    block_t bkt = b.block;
     net_.send( bkt );
     bkt.buf = nullptr;
     bkt.len = 0;
     net_.send( bkt ); // EOF
+    b.block.buf = nullptr;
+    b.block.len = 0;
   }
 
   print( "p1", "disk-done", timestamp<ms>(), time_diff<ms>( t0 ) );
@@ -177,18 +426,27 @@ void Sender::waitFinished( void )
 // over network.
 void Sender::countBucketDistribution( void )
 {
-  rio_.rewind();
+  char * buf = nullptr;
+  if ( posix_memalign( (void **) &buf, IODevice::ODIRECT_ALIGN,
+                       READ_BLOCK ) != 0 ) {
+    throw bad_alloc();
+  }
+  unique_ptr<char, void (*)( void * )> bufGuard( buf, free );
+
   vector<size_t> counts( cluster_.buckets() );
+  vector<uint16_t> bkts( READ_BLOCK / Rec::SIZE );
   size_t recs = 0;
 
-  for ( size_t i = 0;; i++ ) {
-    RecordPtr rec = rio_.next_record();
-    if ( rec.isNull() ) {
+  for ( uint64_t blk = 0;; blk++ ) {
+    size_t n = readBlock( buf, blk ) / Rec::SIZE;
+    if ( n == 0 ) {
       break;
     }
-    recs++;
-    size_t b = cluster_.bucket( rec.key() );
-    counts[b]++;
+    recs += n;
+    cluster_.bucket( buf, n, bkts.data() );
+    for ( size_t i = 0; i < n; i++ ) {
+      counts[bkts[i]]++;
+    }
   }
 
   print( "p0", "records", recs );
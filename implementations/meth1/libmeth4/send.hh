@@ -1,6 +1,8 @@
 #ifndef METH4_SEND_HH
 #define METH4_SEND_HH
 
+#include <atomic>
+#include <mutex>
 #include <thread>
 #include <tuple>
 #include <vector>
@@ -8,9 +10,10 @@
 #include "address.hh"
 #include "channel.hh"
 #include "file.hh"
-#include "overlapped_rec_io.hh"
+#include "pipe.hh"
 #include "socket.hh"
 #include "timestamp.hh"
+#include "wc_scatter.hh"
 
 #include "record.hh"
 
@@ -26,38 +29,94 @@ public:
 
   static constexpr size_t NET_QUEUE_LENGTH = Knobs4::NET_QUEUE_LENGTH;
   static constexpr size_t NET_BLOCK_SIZE = Knobs4::NET_BLOCK_SIZE * Rec::SIZE;
+  static constexpr bool NET_SEND_POLL = Knobs4::NET_SEND_POLL;
+  static constexpr size_t HDRSIZE = sizeof( uint16_t ) + sizeof( uint64_t );
 
   static_assert( NET_BLOCK_SIZE % Rec::SIZE == 0,
     "NET_BLOCK_SIZE not a multiple of Rec::SIZE" );
 
 private:
+  /* a block part way onto the wire to a node (polling sender only) */
+  struct Outgoing
+  {
+    block_t block;
+    char header[HDRSIZE];
+    size_t sent;   // bytes of header and body written
+    size_t active; // bucket EOFs still to send
+    bool busy;
+
+    Outgoing( void )
+      : block{}, header{}, sent{0}, active{0}, busy{false}
+    {}
+  };
+
+  /* one queue per destination node, drained by a blocking thread per node,
+   * or (with NET_SEND_POLL) by one thread polling non-blocking sockets */
   std::vector<TCPSocket> sockets_;
   ClusterMap & cluster_;
-  Channel<block_t> queue_;
-  std::thread netsend_;
+  std::vector<Channel<block_t>> queues_;
+  std::vector<std::thread> netsend_;
+  std::vector<Outgoing> out_;
+  std::pair<Pipe, Pipe> wake_; // a byte per queued block, to wake the poller
 
-  void sendLoop( void );
+  size_t nodeBuckets( size_t node ) const;
+  void sendLoop( size_t node );
+  void pollLoop( void );
+  bool nextBlock( size_t node );
+  void writeBlock( size_t node );
 
 public:
   explicit NetOut( ClusterMap & cluster );
   ~NetOut( void );
 
   void send( block_t block );
+
+  /* Send our key sample to every node. Must come before any blocks. */
+  void sendSample( const std::string & keys );
 };
 
+/* Partition the records of one file into buckets and send them on. Several
+ * workers each claim the file's next read block, bucket it, and scatter the
+ * records (through a write-combining stage) into their own per-bucket
+ * buffers. As those fill, they're merged into a shared network block for the
+ * bucket, which is sent when full. */
 class Sender
 {
 private:
-  static constexpr size_t DISK_QUEUE_LENGTH = Knobs4::DISK_R_QUEUE_LENGTH;
+  static constexpr size_t WORKERS = Knobs4::PARTITION_WORKERS;
+  static constexpr size_t READ_BLOCK =
+    Knobs4::PARTITION_READ_BLOCK * Rec::SIZE;
+  static constexpr size_t LOCAL_BUF = Knobs4::PARTITION_BUF * Rec::SIZE;
+
+  using Stage = WCScatter<Rec::SIZE, Knobs4::PARTITION_STAGE>;
+
+  // reads start on a record boundary and meet O_DIRECT's alignment
+  static_assert( READ_BLOCK % IODevice::ODIRECT_ALIGN == 0,
+    "PARTITION_READ_BLOCK not a multiple of O_DIRECT alignment" );
+  static_assert( LOCAL_BUF % Stage::STAGE == 0,
+    "PARTITION_BUF not a multiple of PARTITION_STAGE" );
+
+  /* a bucket's network block, shared by the workers */
+  struct Bucket
+  {
+    std::mutex lock;
+    block_t block;
+
+    Bucket( void ) : lock{}, block{} {}
+  };
 
-  OverlappedRecordIO<Rec::SIZE> rio_;
+  File & file_;
   ClusterMap & cluster_;
   NetOut & net_;
-  std::vector<block_t> buckets_;
+  std::vector<Bucket> buckets_;
+  std::atomic<uint64_t> nextRead_;
   std::thread sorter_;
   tpoint_t start_;
 
   void _start( void );
+  void partition( void );
+  size_t readBlock( char * buf, uint64_t blk );
+  void merge( uint16_t bkt, const uint8_t * recs, size_t len );
 
 public:
   Sender( File & file, ClusterMap & cluster, NetOut & net );
@@ -0,0 +1,108 @@
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "alloc.hh"
+
+using namespace std;
+using namespace Rec;
+
+namespace {
+
+/* A free list of values. */
+using chain_t = pair<uint8_t *, size_t>;
+
+struct pool_t {
+  mutex mtx {};
+  vector<chain_t> chains {};
+  uint8_t * slab = nullptr;
+  size_t slabLeft = 0;
+};
+
+/* Never destroyed, as values may be freed during static destruction. */
+pool_t & pool( void )
+{
+  static pool_t * p = new pool_t;
+  return *p;
+}
+
+/* Returns a thread's cached values to the pool on thread exit. */
+struct flusher_t {
+  ~flusher_t( void ) { Slab::trim(); }
+};
+
+void attach( void )
+{
+  thread_local flusher_t flusher;
+  (void) flusher;
+}
+
+/* Split `n` values off the front of the thread's free list. */
+chain_t take( Slab::cache_t & c, size_t n )
+{
+  uint8_t * head = c.head, * last = c.head;
+  for ( size_t i = 1; i < n; i++ ) {
+    last = Slab::next( last );
+  }
+  c.head = Slab::next( last );
+  c.count -= n;
+  Slab::set_next( last, nullptr );
+  return { head, n };
+}
+
+}
+
+thread_local Slab::cache_t Slab::cache = { nullptr, 0 };
+
+uint8_t * Slab::refill( void )
+{
+  attach();
+  pool_t & p = pool();
+  chain_t chain;
+  {
+    unique_lock<mutex> lck( p.mtx );
+    if ( not p.chains.empty() ) {
+      chain = p.chains.back();
+      p.chains.pop_back();
+    } else {
+      if ( p.slabLeft == 0 ) {
+        p.slab = new uint8_t[SLAB_VALS * VAL_LEN];
+        p.slabLeft = SLAB_VALS;
+      }
+      chain = { p.slab, BATCH };
+      p.slab += BATCH * VAL_LEN;
+      p.slabLeft -= BATCH;
+
+      // link fresh values together
+      for ( size_t i = 0; i < BATCH; i++ ) {
+        uint8_t * v = chain.first + i * VAL_LEN;
+        set_next( v, i + 1 < BATCH ? v + VAL_LEN : nullptr );
+      }
+    }
+  }
+
+  uint8_t * v = chain.first;
+  cache.head = next( v );
+  cache.count = chain.second - 1;
+  return v;
+}
+
+void Slab::spill( void )
+{
+  attach();
+  chain_t chain = take( cache, BATCH );
+  pool_t & p = pool();
+  unique_lock<mutex> lck( p.mtx );
+  p.chains.push_back( chain );
+}
+
+void Slab::trim( void )
+{
+  if ( cache.count == 0 ) {
+    return;
+  }
+  chain_t chain = take( cache, cache.count );
+  pool_t & p = pool();
+  unique_lock<mutex> lck( p.mtx );
+  p.chains.push_back( chain );
+}
@@ -11,20 +11,96 @@
  * - malloc (glibc)          -- 245ms
  * - new                     -- 285ms
  * - boost::pool (mutex)     -- 540ms
+ *
+ * So by default we use our own slab allocator: values are carved out of large
+ * slabs and recycled through a per-thread free list, only taking a lock to
+ * move a batch of values between a thread and the shared pool. Values are
+ * packed back-to-back, so cost exactly Rec::VAL_LEN bytes each. Slabs are
+ * never returned to the OS, the pool just grows to the peak number of values.
  */
+#include <cstring>
+
+#include "tune_knobs.hh"
+
 #include "record_common.hh"
 
 namespace Rec {
 
+  namespace Slab {
+    /* Values moved between a thread and the shared pool at once. */
+    constexpr size_t BATCH = 1024;
+
+    /* Values allocated per slab. */
+    constexpr size_t SLAB_VALS = BATCH * 64;
+
+    /* Per-thread free list, linked through the first bytes of each value. */
+    struct cache_t {
+      uint8_t * head;
+      size_t count;
+    };
+
+    extern thread_local cache_t cache;
+
+    /* Grab a batch of values from the shared pool, returning one of them. */
+    uint8_t * refill( void );
+
+    /* Return a batch of values from this thread to the shared pool. */
+    void spill( void );
+
+    /* Return all values cached by this thread to the shared pool. */
+    void trim( void );
+
+    inline uint8_t * next( const uint8_t * v ) noexcept
+    {
+      uint8_t * n;
+      memcpy( &n, v, sizeof( n ) );
+      return n;
+    }
+
+    inline void set_next( uint8_t * v, uint8_t * n ) noexcept
+    {
+      memcpy( v, &n, sizeof( n ) );
+    }
+  }
+
   inline uint8_t * alloc_val( void )
   {
-    return new uint8_t[Rec::VAL_LEN];
+    if ( Knobs::SLAB_ALLOC ) {
+      Slab::cache_t & c = Slab::cache;
+      if ( c.head == nullptr ) {
+        return Slab::refill();
+      }
+      uint8_t * v = c.head;
+      c.head = Slab::next( v );
+      c.count--;
+      return v;
+    } else {
+      return new uint8_t[Rec::VAL_LEN];
+    }
   }
 
   inline void dealloc_val( uint8_t * v )
   {
     if ( v != nullptr ) {
-      delete []v;
+      if ( Knobs::SLAB_ALLOC ) {
+        Slab::cache_t & c = Slab::cache;
+        Slab::set_next( v, c.head );
+        c.head = v;
+        if ( ++c.count > 2 * Slab::BATCH ) {
+          Slab::spill();
+        }
+      } else {
+        delete []v;
+      }
+    }
+  }
+
+  /* Bulk reset of this thread's free list, making the values available to
+   * other threads (e.g., the TBB workers performing a parallel merge). */
+  inline void trim_vals( void )
+  {
+    if ( Knobs::SLAB_ALLOC ) {
+      Slab::trim();
     }
   }
 
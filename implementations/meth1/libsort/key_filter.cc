@@ -0,0 +1,139 @@
+#include <cstring>
+
+#include "config.h"
+
+#include "key_filter.hh"
+#include "record_common.hh"
+
+#if defined( HAVE_IMMINTRIN_H ) && \
+  ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define KEY_FILTER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using filter_fn = size_t (*)( const char *, size_t, uint64_t, uint64_t,
+                              uint32_t * );
+
+/* Filter records [start, n), appending survivors to `out` (branchless). */
+inline size_t filter_tail( const char * recs, size_t start, size_t n,
+                           uint64_t lo, uint64_t hi, uint32_t * out )
+{
+  size_t z = 0;
+  for ( size_t i = start; i < n; i++ ) {
+    uint64_t p = Rec::key_prefix( (const uint8_t *) recs + i * Rec::SIZE );
+    out[z] = i;
+    z += p >= lo and p <= hi;
+  }
+  return z;
+}
+
+size_t filter_scalar( const char * recs, size_t n, uint64_t lo, uint64_t hi,
+                      uint32_t * out )
+{
+  return filter_tail( recs, 0, n, lo, hi, out );
+}
+
+#ifdef KEY_FILTER_X86
+/* Load the raw (little-endian) 8 byte key prefix of record i. */
+inline int64_t raw_prefix( const char * recs, size_t i )
+{
+  int64_t p;
+  memcpy( &p, recs + i * Rec::SIZE, sizeof( p ) );
+  return p;
+}
+
+/* Unsigned 64-bit compares are done as signed after flipping the sign bit. */
+constexpr uint64_t SIGN = uint64_t( 1 ) << 63;
+
+__attribute__(( target( "sse4.2" ) ))
+size_t filter_sse42( const char * recs, size_t n, uint64_t lo, uint64_t hi,
+                     uint32_t * out )
+{
+  const __m128i bswap = _mm_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0,
+                                       15, 14, 13, 12, 11, 10, 9, 8 );
+  const __m128i sign = _mm_set1_epi64x( SIGN );
+  const __m128i vlo = _mm_set1_epi64x( lo ^ SIGN );
+  const __m128i vhi = _mm_set1_epi64x( hi ^ SIGN );
+
+  size_t z = 0, i = 0;
+  for ( ; i + 2 <= n; i += 2 ) {
+    __m128i p = _mm_set_epi64x( raw_prefix( recs, i + 1 ),
+                                raw_prefix( recs, i ) );
+    p = _mm_xor_si128( _mm_shuffle_epi8( p, bswap ), sign );
+    __m128i out_range = _mm_or_si128( _mm_cmpgt_epi64( vlo, p ),
+                                      _mm_cmpgt_epi64( p, vhi ) );
+    unsigned mask = ~_mm_movemask_pd( _mm_castsi128_pd( out_range ) ) & 0x3;
+    while ( mask ) {
+      out[z++] = i + __builtin_ctz( mask );
+      mask &= mask - 1;
+    }
+  }
+  return z + filter_tail( recs, i, n, lo, hi, out + z );
+}
+
+__attribute__(( target( "avx2" ) ))
+size_t filter_avx2( const char * recs, size_t n, uint64_t lo, uint64_t hi,
+                    uint32_t * out )
+{
+  const __m256i bswap = _mm256_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0,
+                                          15, 14, 13, 12, 11, 10, 9, 8,
+                                          7, 6, 5, 4, 3, 2, 1, 0,
+                                          15, 14, 13, 12, 11, 10, 9, 8 );
+  const __m256i sign = _mm256_set1_epi64x( SIGN );
+  const __m256i vlo = _mm256_set1_epi64x( lo ^ SIGN );
+  const __m256i vhi = _mm256_set1_epi64x( hi ^ SIGN );
+
+  size_t z = 0, i = 0;
+  for ( ; i + 4 <= n; i += 4 ) {
+    __m256i p = _mm256_set_epi64x( raw_prefix( recs, i + 3 ),
+                                   raw_prefix( recs, i + 2 ),
+                                   raw_prefix( recs, i + 1 ),
+                                   raw_prefix( recs, i ) );
+    p = _mm256_xor_si256( _mm256_shuffle_epi8( p, bswap ), sign );
+    __m256i out_range = _mm256_or_si256( _mm256_cmpgt_epi64( vlo, p ),
+                                         _mm256_cmpgt_epi64( p, vhi ) );
+    unsigned mask =
+      ~_mm256_movemask_pd( _mm256_castsi256_pd( out_range ) ) & 0xF;
+    while ( mask ) {
+      out[z++] = i + __builtin_ctz( mask );
+      mask &= mask - 1;
+    }
+  }
+  return z + filter_tail( recs, i, n, lo, hi, out + z );
+}
+#endif
+
+struct kernel_t {
+  filter_fn fn;
+  const char * name;
+};
+
+kernel_t select_kernel( void )
+{
+#ifdef KEY_FILTER_X86
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    return { filter_avx2, "avx2" };
+  } else if ( __builtin_cpu_supports( "sse4.2" ) ) {
+    return { filter_sse42, "sse4.2" };
+  }
+#endif
+  return { filter_scalar, "scalar" };
+}
+
+const kernel_t kernel_ = select_kernel();
+
+}
+
+size_t KeyFilter::filter( const char * recs, size_t n, uint64_t lo,
+                          uint64_t hi, uint32_t * out )
+{
+  return kernel_.fn( recs, n, lo, hi, out );
+}
+
+const char * KeyFilter::kernel( void )
+{
+  return kernel_.name;
+}
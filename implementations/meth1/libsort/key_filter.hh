@@ -0,0 +1,29 @@
+#ifndef KEY_FILTER_HH
+#define KEY_FILTER_HH
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Range filter over a block of contiguous records on their big-endian key
+ * prefix (`Rec::key_prefix`). We find the index of every record whose prefix
+ * lies in [lo, hi], leaving the caller to resolve records whose prefix ties
+ * with a bound (rare) using a full comparison.
+ *
+ * The kernel is vectorized with AVX2 or SSE4.2 when the CPU supports them,
+ * falling back to a scalar loop otherwise.
+ */
+namespace KeyFilter {
+  /* Maximum records to filter in one call (bounds the index output). */
+  constexpr size_t BATCH = 4096;
+
+  /* Write the index of each record in `recs[0..n)` with a prefix in [lo, hi]
+   * to `out` (size >= n), returning the number of indexes written. */
+  size_t filter( const char * recs, size_t n, uint64_t lo, uint64_t hi,
+                 uint32_t * out );
+
+  /* Name of the kernel selected for this CPU. */
+  const char * kernel( void );
+}
+
+#endif /* KEY_FILTER_HH */
@@ -0,0 +1,124 @@
+#ifndef RADIX_SORT_HH
+#define RADIX_SORT_HH
+
+/**
+ * In-place MSD radix sort (American flag sort) over the 10 byte record key.
+ *
+ * Any record type providing `operator[]` (the boost::sort key-byte accessor)
+ * and `operator<` can be sorted. We permute records in-place by swapping, so
+ * no scratch buffer is needed -- important as the sort buffers are sized
+ * against available memory (see `calc_record_space`). Buckets that are small
+ * enough are finished with std::sort, and large buckets are recursed on in
+ * parallel when TBB is available.
+ *
+ * Records with identical keys are finally ordered with `operator<`, so when
+ * location information is included (WITHLOC) we still produce a total order.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "config.h"
+
+#include "record_common.hh"
+
+#ifdef HAVE_TBB_TASK_GROUP_H
+#include "tbb/task_group.h"
+#endif
+
+namespace Radix {
+  /* Buckets smaller than this are finished with a comparison sort. */
+  constexpr size_t COMPARISON_THRESHOLD = 2048;
+
+  /* Buckets larger than this are sorted as a separate parallel task. */
+  constexpr size_t PARALLEL_THRESHOLD = 1 << 16;
+
+  /* Partition [first, last) in-place on key byte `depth`, filling `bkts` with
+   * the end offset of each of the 256 buckets. */
+  template <typename T>
+  inline void partition( T * first, T * last, size_t depth, size_t * bkts )
+  {
+    size_t count[256] = { 0 };
+    size_t heads[256];
+
+    for ( T * i = first; i < last; i++ ) {
+      count[( *i )[depth]]++;
+    }
+
+    size_t sum = 0;
+    for ( size_t b = 0; b < 256; b++ ) {
+      heads[b] = sum;
+      sum += count[b];
+      bkts[b] = sum;
+    }
+
+    for ( size_t b = 0; b < 256; b++ ) {
+      while ( heads[b] < bkts[b] ) {
+        uint8_t d = first[heads[b]][depth];
+        if ( d == b ) {
+          heads[b]++;
+          continue;
+        }
+        T v = std::move( first[heads[b]] );
+        do {
+          std::swap( v, first[heads[d]++] );
+          d = v[depth];
+        } while ( d != b );
+        first[heads[b]++] = std::move( v );
+      }
+    }
+  }
+
+  template <typename T>
+  void msd_sort( T * first, T * last, size_t depth )
+  {
+    size_t n = last - first;
+
+    if ( n < COMPARISON_THRESHOLD or depth == Rec::KEY_LEN ) {
+      // once all key bytes are consumed, this orders on location information
+      std::sort( first, last );
+      return;
+    }
+
+    size_t bkts[256];
+    partition( first, last, depth, bkts );
+
+#ifdef HAVE_TBB_TASK_GROUP_H
+    if ( n > PARALLEL_THRESHOLD ) {
+      tbb::task_group tg;
+      size_t start = 0;
+      for ( size_t b = 0; b < 256; b++ ) {
+        T * bstart = first + start, * bend = first + bkts[b];
+        if ( size_t( bend - bstart ) > PARALLEL_THRESHOLD ) {
+          tg.run( [bstart, bend, depth]() {
+            msd_sort( bstart, bend, depth + 1 );
+          } );
+        } else if ( bend - bstart > 1 ) {
+          msd_sort( bstart, bend, depth + 1 );
+        }
+        start = bkts[b];
+      }
+      tg.wait();
+      return;
+    }
+#endif
+
+    size_t start = 0;
+    for ( size_t b = 0; b < 256; b++ ) {
+      if ( bkts[b] - start > 1 ) {
+        msd_sort( first + start, first + bkts[b], depth + 1 );
+      }
+      start = bkts[b];
+    }
+  }
+}
+
+template <typename T>
+inline void radix_sort( T * first, T * last )
+{
+  if ( last - first > 1 ) {
+    Radix::msd_sort( first, last, 0 );
+  }
+}
+
+#endif /* RADIX_SORT_HH */
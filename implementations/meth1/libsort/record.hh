@@ -5,7 +5,9 @@
 
 #include "tune_knobs.hh"
 
+#include "radix_sort.hh"
 #include "record_common.hh"
+#include "record_idx.hh"
 #include "record_loc.hh"
 #include "record_ptr.hh"
 #include "record_string.hh"
@@ -25,6 +27,13 @@
 template <typename R>
 inline void rec_sort( R first, R last )
 {
+  if ( Knobs::RADIX_SORT ) {
+    if ( first != last ) {
+      radix_sort( &*first, &*first + ( last - first ) );
+    }
+    return;
+  }
+
 #ifdef HAVE_TBB_PARALLEL_SORT_H
   if ( Knobs::PARALLEL_SORT ) {
     tbb::parallel_sort( first, last );
@@ -39,6 +48,24 @@ inline void rec_sort( R first, R last )
 #endif
 }
 
+/* RecordIdx has no contiguous key bytes for boost::string_sort. */
+inline void rec_sort( RecordIdx * first, RecordIdx * last )
+{
+  if ( Knobs::RADIX_SORT ) {
+    radix_sort( first, last );
+    return;
+  }
+
+#ifdef HAVE_TBB_PARALLEL_SORT_H
+  if ( Knobs::PARALLEL_SORT ) {
+    tbb::parallel_sort( first, last );
+    return;
+  }
+#endif
+
+  std::sort( first, last );
+}
+
 inline int
 own_memcmp( const uint8_t * k1, const uint8_t * k2 ) noexcept
 {
@@ -50,17 +77,48 @@ own_memcmp( const uint8_t * k1, const uint8_t * k2 ) noexcept
   return 0;
 }
 
+/* Integer compare of the key: 8 byte prefix, then the 2 byte tail. */
 inline int
-compare( const uint8_t * k1, uint64_t loc1,
-         const uint8_t * k2, uint64_t loc2 ) noexcept
+int_memcmp( const uint8_t * k1, const uint8_t * k2 ) noexcept
+{
+  uint64_t p1 = Rec::key_prefix( k1 ), p2 = Rec::key_prefix( k2 );
+  if ( p1 != p2 ) {
+    return p1 < p2 ? -1 : 1;
+  }
+  return int( Rec::key_tail( k1 ) ) - int( Rec::key_tail( k2 ) );
+}
+
+/* Compare just two keys, using the method selected by USE_OWN_MEMCMP. */
+inline int
+key_compare( const uint8_t * k1, const uint8_t * k2 ) noexcept
+{
+  switch ( Knobs::USE_OWN_MEMCMP ) {
+  case Knobs::INT_MEMCMP:
+    return int_memcmp( k1, k2 );
+  case Knobs::BYTE_MEMCMP:
+    return own_memcmp( k1, k2 );
+  default:
+    return memcmp( k1, k2, Rec::KEY_LEN );
+  }
+}
+
+/* Compare with the key prefixes already available (possibly cached), so for
+ * INT_MEMCMP the key bytes are only touched when the prefixes tie. */
+inline int
+compare( uint64_t p1, const uint8_t * k1, uint64_t loc1,
+         uint64_t p2, const uint8_t * k2, uint64_t loc2 ) noexcept
 {
   // we compare on key first, and then on loc
   int cmp;
 
-  if ( Knobs::USE_OWN_MEMCMP ) {
-    cmp = own_memcmp( k1, k2 );
+  if ( Knobs::USE_OWN_MEMCMP == Knobs::INT_MEMCMP ) {
+    if ( p1 != p2 ) {
+      return p1 < p2 ? -1 : 1;
+    }
+    cmp = int( Rec::key_tail( k1 ) ) - int( Rec::key_tail( k2 ) );
   } else {
-    cmp = memcmp( k1, k2, Rec::KEY_LEN );
+    (void) p1; (void) p2;
+    cmp = key_compare( k1, k2 );
   }
 
   if ( cmp != 0 ) {
@@ -80,109 +138,117 @@ compare( const uint8_t * k1, uint64_t loc1,
   }
 }
 
+inline int
+compare( const uint8_t * k1, uint64_t loc1,
+         const uint8_t * k2, uint64_t loc2 ) noexcept
+{
+  return compare( Rec::key_prefix( k1 ), k1, loc1,
+                  Rec::key_prefix( k2 ), k2, loc2 );
+}
+
 
 /* RecordS */
 inline int RecordS::compare( const uint8_t * k, uint64_t l ) const noexcept
 {
-  return ::compare( key(), loc(), k, l );
+  return ::compare( prefix(), key(), loc(), Rec::key_prefix( k ), k, l );
 }
 
 inline int RecordS::compare( const char * k, uint64_t l ) const noexcept
 {
-  return ::compare( key(), loc(), (const uint8_t *) k, l );
+  return compare( (const uint8_t *) k, l );
 }
 
 inline int RecordS::compare( const Record & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 inline int RecordS::compare( const RecordS & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 inline int RecordS::compare( const RecordPtr & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 
 /* Record */
 inline int Record::compare( const uint8_t * k, uint64_t l ) const noexcept
 {
-  return ::compare( key(), loc(), k, l );
+  return ::compare( prefix(), key(), loc(), Rec::key_prefix( k ), k, l );
 }
 
 inline int Record::compare( const char * k, uint64_t l ) const noexcept
 {
-  return ::compare( key(), loc(), (const uint8_t *) k, l );
+  return compare( (const uint8_t *) k, l );
 }
 
 inline int Record::compare( const Record & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 inline int Record::compare( const RecordS & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 inline int Record::compare( const RecordPtr & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 
 /* RecordPtr */
 inline int RecordPtr::compare( const uint8_t * k, uint64_t l ) const noexcept
 {
-  return ::compare( key(), loc(), k, l );
+  return ::compare( prefix(), key(), loc(), Rec::key_prefix( k ), k, l );
 }
 
 inline int RecordPtr::compare( const char * k, uint64_t l ) const noexcept
 {
-  return ::compare( key(), loc(), (const uint8_t *) k, l );
+  return compare( (const uint8_t *) k, l );
 }
 
 inline int RecordPtr::compare( const Record & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 inline int RecordPtr::compare( const RecordS & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 inline int RecordPtr::compare( const RecordPtr & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 
 /* RecordLoc */
 inline int RecordLoc::compare( const uint8_t * k, uint64_t l ) const noexcept
 {
-  return ::compare( key(), loc(), k, l );
+  return ::compare( prefix(), key(), loc(), Rec::key_prefix( k ), k, l );
 }
 
 inline int RecordLoc::compare( const RecordLoc & b ) const noexcept
 {
-  return ::compare( key(), loc(), b.key(), b.loc() );
+  return ::compare( prefix(), key(), loc(), b.prefix(), b.key(), b.loc() );
 }
 
 
 /* RecordString */
 inline int RecordString::compare( const uint8_t * k ) const noexcept
 {
-  return ::compare( key(), 0, k, 0 );
+  return ::compare( prefix(), key(), 0, Rec::key_prefix( k ), k, 0 );
 }
 
 inline int RecordString::compare( const RecordString &b ) const noexcept
 {
-  return ::compare( key(), 0, b.key(), 0 );
+  return ::compare( prefix(), key(), 0, b.prefix(), b.key(), 0 );
 }
 
 #endif /* RECORD_HH */
@@ -29,6 +29,29 @@ namespace Rec {
 
   /* Should we include or not include disk location information? */
   enum loc_t { WITH_LOC, NO_LOC };
+
+  /* The first 8 bytes of a key as a big-endian integer, so comparing prefixes
+   * as integers orders the same as comparing the bytes. */
+  inline uint64_t key_prefix( const uint8_t * k ) noexcept
+  {
+    uint64_t p;
+    memcpy( &p, k, sizeof( p ) );
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    p = __builtin_bswap64( p );
+#endif
+    return p;
+  }
+
+  /* The remaining 2 bytes of a key as a big-endian integer. */
+  inline uint16_t key_tail( const uint8_t * k ) noexcept
+  {
+    uint16_t t;
+    memcpy( &t, k + sizeof( uint64_t ), sizeof( t ) );
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    t = __builtin_bswap16( t );
+#endif
+    return t;
+  }
 }
 
 #endif /* RECORD_COMMON_HH */
@@ -20,6 +20,7 @@ public:
   /* Accessors */
   const uint8_t * key( void ) const noexcept { return (uint8_t *) r_; }
   const uint8_t * val( void ) const noexcept { return key() + Rec::KEY_LEN; }
+  uint64_t prefix( void ) const noexcept { return Rec::key_prefix( key() ); }
 
   /* methods for boost::sort */
   const char * data( void ) const noexcept { return r_; }
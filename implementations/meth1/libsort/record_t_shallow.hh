@@ -25,12 +25,23 @@
 class RecordS
 {
 private:
+#if WITHPREFIX == 1
+  uint64_t pfx_ = 0;
+#endif
 #if WITHLOC == 1
   uint64_t loc_ = 0;
 #endif
   uint8_t * val_ = nullptr;
   uint8_t key_[Rec::KEY_LEN];
 
+  void set_key( const uint8_t * k ) noexcept
+  {
+    memcpy( key_, k, Rec::KEY_LEN );
+#if WITHPREFIX == 1
+    pfx_ = Rec::key_prefix( key_ );
+#endif
+  }
+
 public:
   void copy( const uint8_t * k, const uint8_t * v, uint64_t i ) noexcept
   {
@@ -41,7 +52,7 @@ public:
 #endif
     if ( val_ == nullptr ) { val_ = Rec::alloc_val(); }
     memcpy( val_, v, Rec::VAL_LEN );
-    memcpy( key_, k, Rec::KEY_LEN );
+    set_key( k );
   }
 
   void copy( const uint8_t* r, uint64_t i ) noexcept
@@ -60,7 +71,7 @@ public:
     loc_ = r.loc_;
 #endif
     val_ = r.val_;
-    memcpy( key_, r.key_, Rec::KEY_LEN );
+    set_key( r.key_ );
   }
 
   void copy( const RecordPtr & r ) noexcept
@@ -79,6 +90,9 @@ public:
     } else {
       memset( key_, 0x00, Rec::KEY_LEN );
     }
+#if WITHPREFIX == 1
+    pfx_ = Rec::key_prefix( key_ );
+#endif
   }
 
   /* Construct from c string read from disk */
@@ -102,7 +116,7 @@ public:
     : val_{other.val_}
 #endif
   {
-    memcpy( key_, other.key_, Rec::KEY_LEN );
+    set_key( other.key_ );
   }
 
   /* Copy assignment. WARNING: This only does a shallow copy! */
@@ -113,7 +127,7 @@ public:
       loc_ = other.loc_;
 #endif
       val_ = other.val_;
-      memcpy( key_, other.key_, Rec::KEY_LEN );
+      set_key( other.key_ );
     }
     return *this;
   }
@@ -125,7 +139,7 @@ public:
   {
     val_ = other.val_;
     other.val_ = nullptr;
-    memcpy( key_, other.key_, Rec::KEY_LEN );
+    set_key( other.key_ );
   }
 
   RecordS & operator=( RecordS && other )
@@ -138,7 +152,7 @@ public:
       uint8_t * v = val_;
       val_ = other.val_;
       other.val_ = v;
-      memcpy( key_, other.key_, Rec::KEY_LEN );
+      set_key( other.key_ );
     }
     return *this;
   }
@@ -148,6 +162,11 @@ public:
   /* Accessors */
   const uint8_t * key( void ) const noexcept { return key_; }
   const uint8_t * val( void ) const noexcept { return val_; }
+#if WITHPREFIX == 1
+  uint64_t prefix( void ) const noexcept { return pfx_; }
+#else
+  uint64_t prefix( void ) const noexcept { return Rec::key_prefix( key_ ); }
+#endif
 #if WITHLOC == 1
   uint64_t loc( void ) const noexcept { return loc_; }
 #else
@@ -199,6 +199,26 @@ namespace _internal {
         return recv_async();
       }
     }
+
+    bool try_recv( T & t )
+    {
+      {
+        std::unique_lock<std::mutex> lck( mtx_ );
+        if ( size_ == 0 ) {
+          throw std::runtime_error( "try_recv on synchronous channel" );
+        } else if ( closed_ ) {
+          throw closed_error();
+        } else if ( used_ == 0 ) {
+          return false;
+        }
+        used_--;
+        size_t i = rptr_;
+        rptr_ = (rptr_ + 1) % size_;
+        t = std::move( slots_[i] );
+      }
+      send_cv_.notify_one();
+      return true;
+    }
   };
 }
 
@@ -218,6 +238,10 @@ public:
     void send( const T & t ) { chn->send( t ); }
     void send( T && t ) { chn->send( std::move( t ) ); }
     T recv( void ) { return chn->recv(); }
+
+    /* Receive without waiting (buffered channels only). Returns false if
+     * nothing is waiting. */
+    bool try_recv( T & t ) { return chn->try_recv( t ); }
 };
 
 #endif /* CHANNEL_HH */
@@ -1,4 +1,7 @@
+#include <unistd.h>
+
 #include "circular_io.hh"
+#include "exception.hh"
 
 using namespace std;
 
@@ -9,7 +12,10 @@ CircularIO::CircularIO( IODevice & io, size_t blocks, int id )
   : io_{io}
   , buf_{nullptr}
   , bufSize_{blocks * BLOCK}
-  , blocks_{blocks-2}
+  , depth_{dynamic_cast<File *>( &io )
+           ? max<size_t>( 1, min<size_t>( Knobs::IO_QUEUE_DEPTH, blocks-2 ) )
+           : 1}
+  , blocks_{blocks-1-depth_}
   , start_{0}
   , reader_{}
   , io_cb_{[]() {}}
@@ -63,6 +69,12 @@ int CircularIO::id( void ) const noexcept
 void CircularIO::read_loop( void )
 {
   try {
+    unique_ptr<AsyncIO> aio;
+    File * file = dynamic_cast<File *>( &io_ );
+    if ( file != nullptr and depth_ > 1 ) {
+      aio.reset( new AsyncIO( file->fd_num(), depth_ ) );
+    }
+
     while ( true ) {
       size_t nbytes = start_.recv();
       if ( nbytes == 0 ) {
@@ -72,35 +84,11 @@ void CircularIO::read_loop( void )
 
       auto t0 = time_now();
       tdiff_t tread = 0;
-      char * wptr_ = buf_;
-      size_t rbytes = 0;
-      while ( true ) {
-        auto t0 = time_now();
-        // should only issue disk block size reads when using O_DIRECT
-        size_t blkSize = io_.is_odirect()
-          ? BLOCK : min( BLOCK, nbytes - rbytes );
-        size_t n = io_.read( wptr_, blkSize );
-        tread += time_diff<ms>( t0 );
-
-        if ( n > 0 ) {
-          rbytes += n;
-          blocks_.send( {wptr_, n} );
-          wptr_ += BLOCK;
-          if ( wptr_ == buf_ + bufSize_ ) {
-            wptr_ = buf_;
-          }
-        }
-
-        if ( rbytes == nbytes ) {
-          io_cb_();
-          blocks_.send( { nullptr, 0} ); // indicate EOF
-          break;
-        } else if ( rbytes > nbytes ) {
-          throw runtime_error( "read more bytes than should have been" \
-            " available ( " + to_string( rbytes ) + " vs " +
-            to_string( nbytes ) + " )" );
-        }
-      }
+      size_t rbytes = aio ? read_async( *aio, nbytes, tread )
+                          : read_sync( nbytes, tread );
+      io_cb_();
+      blocks_.send( { nullptr, 0} ); // indicate EOF
+
       auto tblocked = time_diff<ms>( t0 );
       print( "circular-read-total", id_, readPass_, rbytes, tread, tblocked );
     }
@@ -111,3 +99,101 @@ void CircularIO::read_loop( void )
     return;
   }
 }
+
+/* read nbytes one block at a time, returning bytes read */
+size_t CircularIO::read_sync( size_t nbytes, tdiff_t & tread )
+{
+  char * wptr_ = buf_;
+  size_t rbytes = 0;
+  while ( rbytes < nbytes ) {
+    auto t0 = time_now();
+    // should only issue disk block size reads when using O_DIRECT
+    size_t blkSize = io_.is_odirect()
+      ? BLOCK : min( BLOCK, nbytes - rbytes );
+    size_t n = io_.read( wptr_, blkSize );
+    tread += time_diff<ms>( t0 );
+
+    if ( n > 0 ) {
+      rbytes += n;
+      blocks_.send( {wptr_, n} );
+      wptr_ += BLOCK;
+      if ( wptr_ == buf_ + bufSize_ ) {
+        wptr_ = buf_;
+      }
+    }
+  }
+
+  if ( rbytes > nbytes ) {
+    throw runtime_error( "read more bytes than should have been" \
+      " available ( " + to_string( rbytes ) + " vs " +
+      to_string( nbytes ) + " )" );
+  }
+  return rbytes;
+}
+
+/* read nbytes with depth_ block reads in flight, returning bytes read */
+size_t CircularIO::read_async( AsyncIO & aio, size_t nbytes, tdiff_t & tread )
+{
+  // reads are positioned, so start from (and then advance) the file offset
+  int fd = dynamic_cast<File &>( io_ ).fd_num();
+  off_t start = SystemCall( "lseek", lseek( fd, 0, SEEK_CUR ) );
+
+  size_t nblocks = ( nbytes + BLOCK - 1 ) / BLOCK;
+  size_t slots = bufSize_ / BLOCK;
+  unique_ptr<size_t[]> done( new size_t[depth_] );
+  unique_ptr<bool[]> ready( new bool[depth_]() );
+
+  // should only issue disk block size reads when using O_DIRECT
+  auto block_size = [&]( size_t i ) {
+    return io_.is_odirect() ? BLOCK : min( BLOCK, nbytes - i * BLOCK );
+  };
+  auto want = [&]( size_t i ) { return min( BLOCK, nbytes - i * BLOCK ); };
+  // (re)submit block i, past the `got` bytes already read
+  auto submit = [&]( size_t i, size_t got ) {
+    done[i % depth_] = got;
+    aio.submit( buf_ + ( i % slots ) * BLOCK + got, block_size( i ) - got,
+                start + i * BLOCK + got, i );
+  };
+
+  // we can only reuse a ring slot once the reader has moved past it, which
+  // the blocks_ capacity (blocks - 1 - depth_) guarantees.
+  size_t next = 0;
+  for ( ; next < min( nblocks, depth_ ); next++ ) {
+    submit( next, 0 );
+  }
+
+  size_t rbytes = 0;
+  for ( size_t i = 0; i < nblocks; i++ ) {
+    auto t0 = time_now();
+    while ( not ready[i % depth_] ) {
+      AsyncIO::completion c = aio.complete();
+      size_t j = c.first, got = done[j % depth_] + c.second;
+      // reads can come back short (e.g., io_uring on cached files), so ask
+      // for the rest, only giving up at end of file
+      if ( c.second > 0 and got < want( j ) ) {
+        submit( j, got );
+      } else {
+        done[j % depth_] = got;
+        ready[j % depth_] = true;
+      }
+    }
+    tread += time_diff<ms>( t0 );
+    ready[i % depth_] = false;
+
+    size_t n = done[i % depth_];
+    if ( n < want( i ) ) {
+      throw runtime_error( "short read from file ( " + to_string( n ) +
+        " vs " + to_string( want( i ) ) + " )" );
+    }
+    // O_DIRECT reads may return past nbytes if the file is larger
+    rbytes += want( i );
+    blocks_.send( {buf_ + ( i % slots ) * BLOCK, want( i )} );
+
+    if ( next < nblocks ) {
+      submit( next++, 0 );
+    }
+  }
+
+  SystemCall( "lseek", lseek( fd, start + rbytes, SEEK_SET ) );
+  return rbytes;
+}
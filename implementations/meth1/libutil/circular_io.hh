@@ -2,6 +2,7 @@
 #define CIRCULAR_IO_HH
 
 #include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <system_error>
@@ -9,6 +10,7 @@
 
 #include "tune_knobs.hh"
 
+#include "async_io.hh"
 #include "channel.hh"
 #include "file.hh"
 #include "sync_print.hh"
@@ -17,6 +19,10 @@
 /**
  * Read from an IODevice in a seperate thread in a block-wise fashion, using a
  * channel for notifying when new blocks are ready.
+ *
+ * When the device is a File, we keep up to `Knobs::IO_QUEUE_DEPTH` block reads
+ * in flight (see AsyncIO) into the ring, rather than issuing one blocking read
+ * at a time. Blocks are still handed out in file order.
  */
 class CircularIO
 {
@@ -30,6 +36,7 @@ private:
   IODevice & io_;
   char * buf_;
   size_t bufSize_;
+  size_t depth_;
   Channel<block_ptr> blocks_;
   Channel<size_t> start_;
   std::thread reader_;
@@ -42,6 +49,12 @@ private:
   /* continually read from the device, taking commands over a channel */
   void read_loop( void );
 
+  /* read nbytes one block at a time, returning bytes read */
+  size_t read_sync( size_t nbytes, tdiff_t & tread );
+
+  /* read nbytes with depth_ block reads in flight, returning bytes read */
+  size_t read_async( AsyncIO & aio, size_t nbytes, tdiff_t & tread );
+
 public:
   CircularIO( IODevice & io, size_t blocks, int id = 0 );
 
@@ -1,6 +1,7 @@
 #ifndef CIRCULAR_IO_REC_HH
 #define CIRCULAR_IO_REC_HH
 
+#include <algorithm>
 #include <cstring>
 #include <system_error>
 
@@ -84,6 +85,33 @@ public:
       return rec_;
     }
   }
+
+  /* Return a run of up to `max` records contiguous in memory, setting `n` to
+   * the number of records in the run (nullptr on EOF). A record crossing a
+   * block boundary is returned as a run of one. */
+  const char * next_records( size_t max, size_t & n )
+  {
+    if ( pos_ == nullptr || pos_ == bend_) {
+      auto blk = next_block();
+      if ( blk.first == nullptr ) {
+        n = 0;
+        return nullptr;
+      }
+      pos_ = blk.first;
+      bend_ = blk.first + blk.second;
+      rrbytes_ += blk.second;
+    }
+
+    n = std::min( max, size_t( bend_ - pos_ ) / rec_size );
+    if ( n == 0 ) {
+      n = 1;
+      return next_record();
+    }
+    const char * p = pos_;
+    pos_ += n * rec_size;
+    recs_ += n;
+    return p;
+  }
 };
 
 #endif /* CIRCULAR_IO_REC_HH */
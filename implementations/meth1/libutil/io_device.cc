@@ -105,3 +105,12 @@ string::const_iterator IODevice::pwrite( const string & buf, off_t offset )
   return it;
 }
 
+size_t IODevice::pwrite_all( const char * buf, size_t nbytes, off_t offset )
+{
+  size_t n = 0;
+  do {
+    n += pwrite( buf + n, nbytes - n, offset + n );
+  } while ( n < nbytes );
+  return n;
+}
+
@@ -59,6 +59,7 @@ public:
 
   virtual size_t pwrite( const char * buf, size_t nbytes, off_t offset ) = 0;
   std::string::const_iterator pwrite( const std::string & buf, off_t offset );
+  size_t pwrite_all( const char * buf, size_t nbytes, off_t offset );
 };
 
 #endif /* IO_DEVICE_HH */
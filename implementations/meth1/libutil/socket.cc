@@ -163,6 +163,30 @@ size_t Socket::write( const char * buf, size_t nbytes )
   return n;
 }
 
+/* non-blocking write method */
+size_t Socket::try_write( const char * buf, size_t nbytes )
+{
+  if ( nbytes == 0 ) {
+    throw runtime_error( "nothing to write" );
+  } else if ( buf == nullptr ) {
+    throw runtime_error( "null buffer for write" );
+  }
+
+  ssize_t n = ::write( fd_num(), buf, nbytes );
+  if ( n < 0 ) {
+    if ( errno == EAGAIN or errno == EWOULDBLOCK ) {
+      return 0;
+    } else {
+      throw unix_error( "write" );
+    }
+  } else if ( n == 0 ) {
+    throw runtime_error( "write returned 0" );
+  }
+  register_write();
+
+  return n;
+}
+
 /* overriden base read method */
 size_t Socket::pread( char *, size_t, off_t )
 {
@@ -49,6 +49,9 @@ public:
   size_t write( const char * buf, size_t nbytes ) override;
   size_t pread( char * buf, size_t limit, off_t offset ) override;
   size_t pwrite( const char * buf, size_t nbytes, off_t offset ) override;
+
+  /* as write, but for a non-blocking socket, returning 0 when it's full */
+  size_t try_write( const char * buf, size_t nbytes );
 };
 
 /* UDP socket */
@@ -0,0 +1,96 @@
+#ifndef WC_SCATTER_HH
+#define WC_SCATTER_HH
+
+/**
+ * Software write-combining for scattering fixed size records to many
+ * destinations. Scattering straight into large buffers touches a different
+ * cache line (and often page) on every record, so nearly every store misses
+ * both cache and TLB once there are more than a few dozen destinations.
+ * Instead each record is staged in a small buffer for its destination -- the
+ * stages together stay cache resident -- and a full stage is copied out in one
+ * go with non-temporal (streaming) stores, which skip the cache and don't
+ * read the destination line before writing it.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+template <size_t RecSize, size_t StageRecs>
+class WCScatter
+{
+public:
+  static constexpr size_t STAGE = RecSize * StageRecs;
+  static constexpr size_t ALIGN = 16;
+
+  // so every stage, and a full flush into an aligned destination, stays
+  // aligned for the vector stores
+  static_assert( STAGE % ALIGN == 0, "stage not a multiple of 16 bytes" );
+
+private:
+  uint8_t * stages_;
+  std::vector<uint32_t> fill_;
+
+public:
+  explicit WCScatter( size_t dests )
+    : stages_{nullptr}
+    , fill_( dests )
+  {
+    if ( posix_memalign( (void **) &stages_, 64, dests * STAGE ) != 0 ) {
+      throw std::bad_alloc();
+    }
+  }
+
+  WCScatter( const WCScatter & ) = delete;
+  WCScatter & operator=( const WCScatter & ) = delete;
+
+  ~WCScatter( void ) { free( stages_ ); }
+
+  /* Stage a record for destination `d`. Returns true once the stage is full,
+   * when it must be flushed before the next add for `d`. */
+  bool add( size_t d, const uint8_t * rec ) noexcept
+  {
+    uint32_t & n = fill_[d];
+    memcpy( stages_ + d * STAGE + n * RecSize, rec, RecSize );
+    return ++n == StageRecs;
+  }
+
+  /* Bytes staged for destination `d` */
+  size_t staged( size_t d ) const noexcept { return fill_[d] * RecSize; }
+
+  /* Copy destination `d`'s staged records to `dst` (which must be 16 byte
+   * aligned) and empty the stage. Returns the number of bytes copied. The
+   * copy is only ordered with other stores after a call to `fence`. */
+  size_t flush( size_t d, uint8_t * dst ) noexcept
+  {
+    size_t len = fill_[d] * RecSize;
+    const uint8_t * src = stages_ + d * STAGE;
+    size_t i = 0;
+#ifdef __SSE2__
+    for ( ; i + ALIGN <= len; i += ALIGN ) {
+      __m128i v = _mm_load_si128( (const __m128i *) ( src + i ) );
+      _mm_stream_si128( (__m128i *) ( dst + i ), v );
+    }
+#endif
+    memcpy( dst + i, src + i, len - i );
+    fill_[d] = 0;
+    return len;
+  }
+
+  /* Make all flushed records visible before any later store (e.g., before
+   * handing a destination buffer to another thread). */
+  static void fence( void ) noexcept
+  {
+#ifdef __SSE2__
+    _mm_sfence();
+#endif
+  }
+};
+
+#endif /* WC_SCATTER_HH */
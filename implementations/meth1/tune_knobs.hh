@@ -17,6 +17,9 @@ namespace Knobs {
   static constexpr uint64_t IO_BLOCK = 4096 * 256 * 10; // 10MB
   static constexpr uint64_t DISK_BLOCKS = 400;          // 4000MB
 
+  /* Block reads kept in flight per file by CircularIO (io_uring / AIO) */
+  static constexpr uint64_t IO_QUEUE_DEPTH = 4;
+
   /* Buffered (not overlapped) IO size */
   static constexpr uint64_t IO_BUFFER_DEFAULT = 1024 * 1024;
 
@@ -26,6 +29,21 @@ namespace Knobs {
   /* Size (in records) of client writer buffer */
   static constexpr uint64_t CLIENT_WRITE_BUFFER = 1024 * 100; // 10MB
 
+  /* Threads to split the multi-node client merge over by key range (1 to
+   * merge all records through a single thread). */
+  static constexpr std::size_t CLIENT_MERGE_THREADS = 4;
+
+  /* Records buffered per node for each round of the parallel client merge. */
+  static constexpr uint64_t CLIENT_MERGE_BUFFER = 1024 * 1024; // 100MB
+
+  /* Key prefix bits used to bucket records for ReadMany (percentile / CDF)
+   * queries. Each node caches a histogram of 2^BITS buckets. */
+  static constexpr uint64_t READ_MANY_BUCKET_BITS = 16;
+
+  /* Most records (over all nodes) ReadMany fetches to place one position --
+   * a denser key range is first narrowed by another key byte. */
+  static constexpr uint64_t READ_MANY_RECORDS = 1024;
+
   /* Memory to leave unused for OS and other misc purposes. */
   static constexpr uint64_t MEM_RESERVE = 0;
 
@@ -46,14 +64,29 @@ namespace Knobs {
    * the results returned by scan are invalidate when you next call scan. */
   static constexpr bool REUSE_MEM = true;
 
+  /* Filter, sort and merge just 16 byte (key, location) tuples, gathering the
+   * record values for a read in one final pass over the disks, straight into
+   * the network buffer? Costs an extra disk pass per read, but cuts merge
+   * memory traffic and avoids allocating a value for every candidate. */
+  static constexpr bool INDEX_SORT = false;
+
   /* Use a parallel merge implementation? */
   static constexpr bool PARALLEL_MERGE = true;
 
+  /* Allocate record values from our slab allocator rather than `new`? */
+  static constexpr bool SLAB_ALLOC = true;
+
   /* Use parallel sort? */
   static constexpr bool PARALLEL_SORT = true;
 
-  /* Use hand-rolled memcmp? */
-  static constexpr bool USE_OWN_MEMCMP = true;
+  /* Use our in-place MSD radix sort rather than a comparison sort? Takes
+   * precedence over PARALLEL_SORT (the radix sort is itself parallel). */
+  static constexpr bool RADIX_SORT = true;
+
+  /* How to compare keys: libc memcmp, a hand-rolled byte loop, or as a
+   * big-endian 8 byte prefix + 2 byte tail integer compare? */
+  enum memcmp_t { LIBC_MEMCMP, BYTE_MEMCMP, INT_MEMCMP };
+  static constexpr memcmp_t USE_OWN_MEMCMP = INT_MEMCMP;
 
   /* Record -- use packed data structure? */
   #define PACKED 1
@@ -65,6 +98,11 @@ namespace Knobs {
    * duplicate keys aren't common, it's generally fine to not include location
    * information. */
   #define WITHLOC 0
+
+  /* RecordS & RecordLoc -- cache the big-endian 8 byte key prefix? Saves
+   * reloading and byte-swapping the key on every comparison (only useful with
+   * INT_MEMCMP), at the cost of 8 bytes per record. */
+  #define WITHPREFIX 0
 }
 
 #endif /* TUNE_KNOBS_HH */
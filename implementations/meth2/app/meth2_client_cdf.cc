@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "exception.hh"
+#include "timestamp.hh"
 #include "util.hh"
 
 #include "record.hh"
@@ -49,8 +50,17 @@ int run( int argc, char * argv[] )
   cout << "Size: " << size << endl;
   uint64_t points = stoul( argv[1] );
 
+  vector<uint64_t> positions;
   for (uint64_t i = 0; i < points; i++) {
-      c.Read(size * i / points, 1);
+      positions.push_back(size * i / points);
+  }
+
+  auto t0 = time_now();
+  auto recs = c.ReadMany(positions);
+  cout << "ReadMany: " << time_diff<ms>(t0) << "mS" << endl;
+
+  for (uint64_t i = 0; i < points; i++) {
+      cout << positions[i] << ", " << recs[i] << endl;
   }
 
   return EXIT_SUCCESS;
@@ -1,4 +1,8 @@
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "buffered_io.hh"
 #include "exception.hh"
@@ -18,9 +22,42 @@ Client::Client( Address node )
   , rpcStart_{}
   , rpcPos_{0}
 {
+  // pipelined requests mustn't wait on Nagle's algorithm
+  sock_.io().set_nodelay();
   sock_.io().connect( addr_ );
 }
 
+string Client::msgRead( uint64_t pos, uint64_t siz )
+{
+  string data( 1 + 2 * sizeof( uint64_t ), '\0' );
+  data[0] = 0;
+  memcpy( &data[1], &pos, sizeof( uint64_t ) );
+  memcpy( &data[1 + sizeof( uint64_t )], &siz, sizeof( uint64_t ) );
+  return data;
+}
+
+string Client::msgIRead( uint64_t pos, uint64_t siz )
+{
+  string data = msgRead( pos, siz );
+  data[0] = 1;
+  return data;
+}
+
+string Client::msgSize( void )
+{
+  return string( 1, 2 );
+}
+
+void Client::sendTagged( uint64_t tag, const string & req )
+{
+  string data( 1 + 2 * sizeof( uint64_t ), '\0' );
+  uint64_t len = req.size();
+  data[0] = 7;
+  memcpy( &data[1], &tag, sizeof( uint64_t ) );
+  memcpy( &data[1 + sizeof( uint64_t )], &len, sizeof( uint64_t ) );
+  sock_.io().write_all( data + req );
+}
+
 void Client::sendRead( uint64_t pos, uint64_t siz )
 {
   static int pass = 0;
@@ -29,11 +66,7 @@ void Client::sendRead( uint64_t pos, uint64_t siz )
 
   //cout << "start-read, " << pass++ << ", " << pos << ", " << siz << endl;
 
-  char data[1 + 2 * sizeof( uint64_t )];
-  data[0] = 0;
-  *reinterpret_cast<uint64_t *>( data + 1 ) = pos;
-  *reinterpret_cast<uint64_t *>( data + 1 + sizeof( uint64_t ) ) = siz;
-  sock_.io().write_all( data, sizeof( data ) );
+  sock_.io().write_all( msgRead( pos, siz ) );
 }
 
 uint64_t Client::recvRead( void )
@@ -64,11 +97,7 @@ void Client::sendIRead( uint64_t pos, uint64_t siz )
 
   //cout << "start-iread, " << pass++ << ", " << pos << ", " << siz << endl;
 
-  char data[1 + 2 * sizeof( uint64_t )];
-  data[0] = 1;
-  *reinterpret_cast<uint64_t *>( data + 1 ) = pos;
-  *reinterpret_cast<uint64_t *>( data + 1 + sizeof( uint64_t ) ) = siz;
-  sock_.io().write_all( data, sizeof( data ) );
+  sock_.io().write_all( msgIRead( pos, siz ) );
 }
 
 uint64_t Client::recvIRead( void )
@@ -93,11 +122,83 @@ RecordLoc Client::readIRecord( void )
   return recLoc;
 }
 
+void Client::sendQuantiles( uint64_t k )
+{
+  char data[1 + sizeof( uint64_t )];
+  data[0] = 4;
+  *reinterpret_cast<uint64_t *>( data + 1 ) = k;
+  sock_.io().write_all( data, sizeof( data ) );
+}
+
+vector<pair<uint64_t, RecordLoc>> Client::recvQuantiles( uint64_t & size )
+{
+  auto str = sock_.read_buf_all( 2 * sizeof( uint64_t ) ).first;
+  size = *reinterpret_cast<const uint64_t *>( str );
+  uint64_t k = *( reinterpret_cast<const uint64_t *>( str ) + 1 );
+
+  vector<pair<uint64_t, RecordLoc>> qs( k );
+  for ( auto & q : qs ) {
+    sock_.read_all( reinterpret_cast<char *>( &q.first ), sizeof( uint64_t ) );
+    q.second.read( sock_ );
+  }
+  return qs;
+}
+
+void Client::sendCount( const vector<RecordLoc> & keys )
+{
+  string data( 1 + sizeof( uint64_t ) + keys.size() * Rec::KEY_LEN, '\0' );
+  data[0] = 5;
+  *reinterpret_cast<uint64_t *>( &data[1] ) = keys.size();
+  char * k = &data[1 + sizeof( uint64_t )];
+  for ( auto & r : keys ) {
+    memcpy( k, r.key(), Rec::KEY_LEN );
+    k += Rec::KEY_LEN;
+  }
+  sock_.io().write_all( data );
+}
+
+vector<uint64_t> Client::recvCount( uint64_t m )
+{
+  vector<uint64_t> counts( m );
+  sock_.read_all( reinterpret_cast<char *>( counts.data() ),
+                  m * sizeof( uint64_t ) );
+  return counts;
+}
+
+void Client::sendReadMany( const vector<uint64_t> & positions )
+{
+  uint64_t m = positions.size();
+  string data( 1 + ( m + 1 ) * sizeof( uint64_t ), '\0' );
+  data[0] = 6;
+  memcpy( &data[1], &m, sizeof( uint64_t ) );
+  memcpy( &data[1 + sizeof( uint64_t )], positions.data(),
+          m * sizeof( uint64_t ) );
+  sock_.io().write_all( data );
+}
+
+uint64_t Client::recvReadMany( void )
+{
+  auto nrecsStr = sock_.read_buf_all( sizeof( uint64_t ) ).first;
+  return *reinterpret_cast<const uint64_t *>( nrecsStr );
+}
+
+void Client::sendModel( void )
+{
+  int8_t rpc = 3;
+  sock_.io().write_all( (char *)&rpc, 1 );
+}
+
+KeyModel Client::recvModel( void )
+{
+  KeyModel m;
+  m.read( sock_ );
+  return m;
+}
+
 void Client::sendSize( void )
 {
   //rpcStart_ = time_now();
-  int8_t rpc = 2;
-  sock_.io().write_all( (char *)&rpc, 1 );
+  sock_.io().write_all( msgSize() );
 }
 
 uint64_t Client::recvSize( void )
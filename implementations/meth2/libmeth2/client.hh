@@ -1,6 +1,10 @@
 #ifndef METH2_CLIENT2_HH
 #define METH2_CLIENT2_HH
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "address.hh"
 #include "buffered_io.hh"
 #include "socket.hh"
@@ -8,6 +12,8 @@
 
 #include "record.hh"
 
+#include "key_model.hh"
+
 /**
  * Strategy 2
  */
@@ -32,6 +38,15 @@ public:
 public:
   Client( Address node );
 
+  /* Request messages, for sending directly or wrapped in a tagged frame */
+  static std::string msgRead( uint64_t pos, uint64_t size );
+  static std::string msgIRead( uint64_t pos, uint64_t size );
+  static std::string msgSize( void );
+
+  /* Send a request in a (tag, length) frame -- the reply comes back framed
+   * the same way, see RpcQueue. */
+  void sendTagged( uint64_t tag, const std::string & req );
+
   /* Perform a read. Return value is number of records available to read */
   void sendRead( uint64_t pos, uint64_t size );
   uint64_t recvRead( void );
@@ -42,6 +57,23 @@ public:
   uint64_t recvIRead( void );
   RecordLoc readIRecord( void );
 
+  /* Fetch the server's size and `k` evenly spaced (rank, record) samples */
+  void sendQuantiles( uint64_t k );
+  std::vector<std::pair<uint64_t, RecordLoc>> recvQuantiles( uint64_t & size );
+
+  /* Count the records below each of a batch of keys */
+  void sendCount( const std::vector<RecordLoc> & keys );
+  std::vector<uint64_t> recvCount( uint64_t m );
+
+  /* Fetch the full records at each of a batch of positions. Return value is
+   * number of records available to read */
+  void sendReadMany( const std::vector<uint64_t> & positions );
+  uint64_t recvReadMany( void );
+
+  /* Fetch the server's key -> rank model */
+  void sendModel( void );
+  KeyModel recvModel( void );
+
   /* Return the number of records available at this server */
   void sendSize( void );
   uint64_t recvSize( void );
@@ -1,24 +1,32 @@
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "block_writer.hh"
 #include "buffered_io.hh"
-#include "channel.hh"
 #include "file.hh"
+#include "loser_tree.hh"
+#include "string_io.hh"
 
 #include "record.hh"
 
 #include "client.hh"
 #include "cluster.hh"
 #include "exception.hh"
-#include "priority_queue.hh"
 #include "remote_file.hh"
+#include "rpc_queue.hh"
 
 using namespace std;
 using namespace meth2;
 
 Cluster::Cluster( vector<Address> nodes, uint64_t chunkSize )
   : clients_{}
+  , models_{}
   , chunkSize_{chunkSize}
 {
   for ( auto & n : nodes ) {
@@ -44,168 +52,234 @@ uint64_t Cluster::Size( void )
   return size;
 }
 
-uint64_t
-GetLargest(std::vector<Cluster::NodeSplit> &ns)
+/* Key order, breaking ties on node so every record has a unique rank. */
+struct NodeKey
 {
-    uint64_t n = 0;
+    RecordLoc key;
+    uint32_t node;
 
-    for (uint64_t i = 0; i < ns.size(); i++) {
-	if (ns[n].key.compare(ns[i].key) <= 0) {
-	    n = i;
-	}
+    bool operator<(const NodeKey &b) const noexcept
+    {
+	int c = key.compare(b.key);
+	return c != 0 ? c < 0 : node < b.node;
     }
+};
 
-    return n;
+static bool
+key_less(const RecordLoc &a, const RecordLoc &b)
+{
+    return a.compare(b) < 0;
 }
 
-uint64_t
-GetSmallest(std::vector<Cluster::NodeSplit> &ns)
+std::vector<Cluster::NodeSplit>
+Cluster::GetSplit(uint64_t n)
 {
-    uint64_t n = 0;
+    return GetSplits({n})[0];
+}
 
-    for (uint64_t i = 0; i < ns.size(); i++) {
-	if (ns[n].key.compare(ns[i].key) > 0) {
-	    n = i;
+/* Find how many records each node contributes to the first n records overall,
+ * for a batch of n's, in three parallel round trips:
+ * 1. QUANTILES: each node's size and evenly spaced sample keys. These bound
+ *    the global rank of any key, as does each node's key model (fetched with
+ *    the first batch and cached), so for each n we keep just the sample keys
+ *    whose rank is uncertain around n (plus the nearest sure ones).
+ * 2. COUNT: every node counts the records below each remaining key, giving
+ *    their exact global ranks and so the two adjacent keys bracketing n.
+ * 3. IRead: each node sends its (few) records between those two keys, which
+ *    we merge locally to place the n-th record exactly. */
+std::vector<std::vector<Cluster::NodeSplit>>
+Cluster::GetSplits(std::vector<uint64_t> targets)
+{
+    size_t N = clients_.size();
+
+    // 1. sample
+    vector<uint64_t> sizes(N);
+    vector<vector<pair<uint64_t, RecordLoc>>> qs(N);
+    bool fetchModels = models_.size() != N;
+    for (auto &c : clients_) {
+	c.sendQuantiles(Knobs::SPLIT_SAMPLES);
+	if (fetchModels) {
+	    c.sendModel();
+	}
+    }
+    for (size_t i = 0; i < N; i++) {
+	qs[i] = clients_[i].recvQuantiles(sizes[i]);
+	if (fetchModels) {
+	    models_.push_back(clients_[i].recvModel());
 	}
     }
 
-    return n;
-}
-
-bool
-SplitDone(std::vector<Cluster::NodeSplit> &ns)
-{
-    for (uint64_t i = 0; i < ns.size(); i++) {
-	for (uint64_t j = 0; j < ns.size(); j++) {
-	    //cout << i << "IJ" << j << endl;
-	    if (ns[i].key.compare(ns[j].nextKey) > 0)
-		return false;
+    vector<RecordLoc> cands;
+    for (auto &q : qs) {
+	for (auto &s : q) {
+	    cands.push_back(s.second);
+	}
+    }
+    sort(cands.begin(), cands.end(), key_less);
+    cands.erase(unique(cands.begin(), cands.end(),
+		       [](const RecordLoc &a, const RecordLoc &b) {
+			   return a.compare(b) == 0;
+		       }), cands.end());
+
+    // bounds on the global count of records below a key: from the samples
+    // either side of it, narrowed by the model windows for its prefix (only
+    // while the model still matches the node's size)
+    auto bounds = [&](const RecordLoc &x) {
+	uint64_t lb = 0, ub = 0;
+	uint64_t p = x.prefix();
+	for (size_t i = 0; i < N; i++) {
+	    size_t j = lower_bound(qs[i].begin(), qs[i].end(), x,
+		[](const pair<uint64_t, RecordLoc> &a, const RecordLoc &b) {
+		    return a.second.compare(b) < 0;
+		}) - qs[i].begin();
+	    uint64_t l = j > 0 ? qs[i][j - 1].first + 1 : 0;
+	    uint64_t u = j < qs[i].size() ? qs[i][j].first : sizes[i];
+	    const KeyModel &m = models_[i];
+	    if (m.size() == sizes[i]) {
+		l = max(l, m.window(p).first);
+		if (p < UINT64_MAX) {
+		    u = min(u, m.window(p + 1).second);
+		}
+	    }
+	    lb += l;
+	    ub += max(l, u);
+	}
+	return make_pair(lb, ub);
+    };
+
+    // keep candidates whose count may straddle a target
+    vector<bool> keep(cands.size(), false);
+    for (uint64_t n : targets) {
+	size_t lo = 0, hi = cands.size();
+	for (size_t k = 0; k < cands.size(); k++) {
+	    auto b = bounds(cands[k]);
+	    if (b.second <= n) {
+		lo = k;
+	    } else if (b.first > n) {
+		hi = k;
+		break;
+	    }
+	}
+	for (size_t k = lo; k < cands.size() and k <= hi; k++) {
+	    keep[k] = true;
+	}
+    }
+    vector<RecordLoc> probe;
+    for (size_t k = 0; k < cands.size(); k++) {
+	if (keep[k]) {
+	    probe.push_back(cands[k]);
 	}
     }
 
-    return true;
-}
+    // 2. count
+    vector<vector<uint64_t>> counts(N);
+    for (auto &c : clients_) {
+	c.sendCount(probe);
+    }
+    for (size_t i = 0; i < N; i++) {
+	counts[i] = clients_[i].recvCount(probe.size());
+    }
 
-std::vector<Cluster::NodeSplit>
-Cluster::GetSplit(uint64_t n)
-{
-    uint64_t i;
-    std::vector<NodeSplit> ns;
-
-    //auto rmid = IRead(clients_[0], Size(clients_[0]) / 2, 1);
-    //auto rsrch = IBSearch(clients_[0], rmid[0]);
-
-    for (i = 0; i < clients_.size(); i++) {
-	ns.emplace_back();
-	ns[i].clientNo = i;
-	ns[i].size = Size(clients_[i]);
-	ns[i].start = 0;
-	ns[i].end = n - 1;
-	ns[i].n = n / clients_.size();
-    }
-    // Adjust ns[0].n to account for rounding
-    ns[0].n += n - (ns[0].n * clients_.size());
-
-    for (i = 0; i < clients_.size(); i++) {
-	// Read n and n+1
-	vector<RecordLoc> rl = IRead(clients_[i], ns[i].n, 2);
-	ns[i].key = rl[0];
-	ns[i].nextKey = rl[1];
-    }
-
-    /*for (auto &n : ns)
-	n.dump();*/
-
-    while (!SplitDone(ns)) {
-	uint64_t largest, smallest, step;
-	uint64_t newStart, newEnd;
-
-	largest = GetLargest(ns);
-	smallest = GetSmallest(ns);
-
-	newStart = IBSearch(clients_[ns[largest].clientNo],
-			    ns[smallest].key);
-	newEnd = ns[largest].n;
-	if (newStart > ns[largest].start)
-	    ns[largest].start = newStart;
-	if (newEnd < ns[largest].end)
-	    ns[largest].end = newEnd;
-
-	newStart = ns[smallest].n;
-	newEnd = IBSearch(clients_[ns[smallest].clientNo],
-			  ns[largest].key);
-	if (newStart > ns[smallest].start)
-	    ns[smallest].start = newStart;
-	if (newEnd < ns[smallest].end)
-	    ns[smallest].end = newEnd;
-
-	uint64_t largestStep = ns[largest].end - ns[largest].start;
-	uint64_t smallestStep = ns[smallest].end - ns[smallest].start;
-	step = (largestStep > smallestStep) ? smallestStep : largestStep;
-    
-	step /= 2;
-	if (step == 0)
-	    step = 1;
-
-	ns[largest].n -= step;
-	ns[smallest].n += step;
-
-	for (i = 0; i < clients_.size(); i++) {
-	    // Read n and n+1
-	    vector<RecordLoc> rl = IRead(clients_[i], ns[i].n, 2);
-	    ns[i].key = rl[0];
-	    ns[i].nextKey = rl[1];
+    // bracket each target: [lo_i, hi_i) on each node holds the n-th record
+    vector<vector<NodeSplit>> splits;
+    vector<vector<pair<uint64_t, uint64_t>>> windows;
+    vector<uint64_t> below;
+    for (uint64_t n : targets) {
+	vector<pair<uint64_t, uint64_t>> w(N);
+	for (size_t i = 0; i < N; i++) {
+	    w[i] = {0, sizes[i]};
 	}
-
-	/*for (auto &n : ns)
-	    n.dump();*/
+	uint64_t g_lo = 0;
+	for (size_t k = 0; k < probe.size(); k++) {
+	    uint64_t g = 0;
+	    for (size_t i = 0; i < N; i++) {
+		g += counts[i][k];
+	    }
+	    if (g <= n) {
+		g_lo = g;
+		for (size_t i = 0; i < N; i++) {
+		    w[i].first = counts[i][k];
+		}
+	    } else {
+		for (size_t i = 0; i < N; i++) {
+		    w[i].second = counts[i][k];
+		}
+		break;
+	    }
+	}
+	windows.push_back(w);
+	below.push_back(g_lo);
     }
 
-    //for (auto &n : ns)
-    // n.dump();
+    // 3. fetch the windows, taking replies as they arrive from any node, and
+    //    place each target exactly
+    RpcQueue q{clients_};
+    unordered_map<uint64_t, size_t> tagTarget;
+    for (size_t t = 0; t < targets.size(); t++) {
+	for (size_t i = 0; i < N; i++) {
+	    auto &w = windows[t][i];
+	    uint64_t tag = q.post(i, Client::msgIRead(w.first,
+						      w.second - w.first));
+	    tagTarget[tag] = t;
+	}
+    }
+    vector<vector<NodeKey>> found(targets.size());
+    while (q.outstanding() > 0) {
+	auto c = q.next();
+	for (auto &r : IRecords(c.reply)) {
+	    found[tagTarget[c.tag]].push_back({r, uint32_t(c.client)});
+	}
+    }
+    for (size_t t = 0; t < targets.size(); t++) {
+	vector<NodeKey> &recs = found[t];
+	sort(recs.begin(), recs.end());
+
+	vector<NodeSplit> ns(N);
+	for (size_t i = 0; i < N; i++) {
+	    ns[i].clientNo = i;
+	    ns[i].size = sizes[i];
+	    ns[i].start = windows[t][i].first;
+	    ns[i].end = windows[t][i].second;
+	    ns[i].n = windows[t][i].first;
+	}
+	uint64_t take = min<uint64_t>(targets[t] - below[t], recs.size());
+	for (uint64_t j = 0; j < take; j++) {
+	    ns[recs[j].node].n++;
+	}
+	splits.push_back(ns);
+    }
 
-    return ns;
+    return splits;
 }
 
-uint64_t
-Cluster::IBSearch( Client &c, RecordLoc &rl )
+/* Decode the records of a (tagged) IRead reply. */
+vector<RecordLoc>
+Cluster::IRecords( const string &reply )
 {
-    vector<RecordLoc> tmp;
-    uint64_t start = 0;
-    uint64_t end = Size(c);
-    uint64_t pos = end / 2;
-
-    //cout << "IBSearch" << endl;
-    while (start < end) {
-	//cout << start << ", " << end << ", " << pos << endl;
-	tmp = IRead(c, pos, 1);
-	int val = tmp[0].compare(rl);
-	if (val > 0) {
-	    end = pos;
-	    pos = (start + end) / 2;
-	} else if (val < 0) {
-	    start = pos + 1;
-	    pos = (start + end) / 2;
-	} else {
-	    return pos;
-	}
-    }
-    //cout << "IBSearch" << endl;
+    StringIO in{reply};
+    uint64_t nrecs = 0;
+    in.read_all(reinterpret_cast<char *>(&nrecs), sizeof(uint64_t));
 
-    return pos;
+    vector<RecordLoc> rl(nrecs);
+    for (auto &r : rl) {
+	r.read(in);
+    }
+    return rl;
 }
 
 Record Cluster::ReadFirst( void )
 {
-  for ( auto & c : clients_ ) {
-    c.sendRead( 0, 1 );
+  RpcQueue q{clients_};
+  for ( size_t i = 0; i < clients_.size(); i++ ) {
+    q.post( i, Client::msgRead( 0, 1 ) );
   }
 
   Record min( Rec::MAX );
-  for ( auto & c : clients_ ) {
-    uint64_t s = c.recvRead();
+  while ( q.outstanding() > 0 ) {
+    auto c = q.next();
+    uint64_t s = *reinterpret_cast<const uint64_t *>( c.reply.data() );
     if ( s >= 1 ) {
-      RecordPtr p = c.readRecord();
+      RecordPtr p( c.reply.data() + sizeof( uint64_t ) );
       if ( p < min ) {
         min.copy( p );
       }
@@ -232,7 +306,7 @@ void Cluster::Read( uint64_t pos, uint64_t len )
     // general n node case
     vector<NodeSplit> ns = GetSplit(pos);
     vector<RemoteFile> files;
-    mystl::priority_queue_min<RemoteFile> pq{clients_.size()};
+    LoserTree<RemoteKey> lt{clients_.size()};
     uint64_t size = Size() - pos;
 
     // Ensure we read the correct number of records
@@ -257,18 +331,24 @@ void Cluster::Read( uint64_t pos, uint64_t len )
     }
 
     // prep -- 1st record
-    for ( auto & f : files ) {
-      f.nextRecord();
-      pq.push( f );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+      if ( files[i].eof() ) {
+        lt.close( i );
+      } else {
+        files[i].nextRecord();
+        lt.set( i, RemoteKey( files[i].curRecord() ) );
+      }
     }
+    lt.build();
 
     // read all records
-    for ( uint64_t i = 0; i < size; i++ ) {
-      RemoteFile f = pq.top();
-      pq.pop();
+    for ( uint64_t i = 0; i < size and not lt.empty(); i++ ) {
+      RemoteFile & f = files[lt.top()];
       if ( !f.eof() ) {
         f.nextRecord();
-        pq.push( f );
+        lt.replace_top( RemoteKey( f.curRecord() ) );
+      } else {
+        lt.pop_top();
       }
     }
 
@@ -279,6 +359,53 @@ void Cluster::Read( uint64_t pos, uint64_t len )
   }
 }
 
+/* Retrieve the records at each of `positions` (e.g., for a CDF). One batched
+ * GetSplits places every position on each node, and then each node returns
+ * the candidate record at each position in a single READ_MANY -- the record
+ * at a position is the smallest candidate across nodes. */
+vector<Record> Cluster::ReadMany( const vector<uint64_t> & positions )
+{
+  size_t N = clients_.size();
+  vector<vector<NodeSplit>> splits = GetSplits( positions );
+
+  // ask each node for its candidate at every position it hasn't exhausted
+  vector<vector<size_t>> which( N );
+  for ( size_t i = 0; i < N; i++ ) {
+    vector<uint64_t> pos;
+    for ( size_t j = 0; j < positions.size(); j++ ) {
+      if ( splits[j][i].n < splits[j][i].size ) {
+        which[i].push_back( j );
+        pos.push_back( splits[j][i].n );
+      }
+    }
+    clients_[i].sendReadMany( pos );
+  }
+
+  // ties on key go to the lowest node, matching the order GetSplits uses
+  vector<Record> out( positions.size(), Record( Rec::MAX ) );
+  vector<bool> found( positions.size(), false );
+  for ( size_t i = 0; i < N; i++ ) {
+    uint64_t nrecs = clients_[i].recvReadMany();
+    if ( nrecs != which[i].size() ) {
+      throw runtime_error( "ReadMany reply has the wrong number of records" );
+    }
+    for ( auto j : which[i] ) {
+      RecordPtr p = clients_[i].readRecord();
+      if ( not found[j] or p < out[j] ) {
+        out[j].copy( p );
+        found[j] = true;
+      }
+    }
+  }
+
+  for ( size_t j = 0; j < positions.size(); j++ ) {
+    if ( not found[j] ) {
+      throw runtime_error( "ReadMany position outside of range" );
+    }
+  }
+  return out;
+}
+
 void Cluster::ReadAll( void )
 {
   if ( clients_.size() == 1 ) {
@@ -295,7 +422,7 @@ void Cluster::ReadAll( void )
   } else {
     // general n node case
     vector<RemoteFile> files;
-    mystl::priority_queue_min<RemoteFile> pq{clients_.size()};
+    LoserTree<RemoteKey> lt{clients_.size()};
     uint64_t size = Size();
 
     // prep -- size
@@ -312,48 +439,29 @@ void Cluster::ReadAll( void )
     }
 
     // prep -- 1st record
-    for ( auto & f : files ) {
-      f.nextRecord();
-      pq.push( f );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+      if ( files[i].eof() ) {
+        lt.close( i );
+      } else {
+        files[i].nextRecord();
+        lt.set( i, RemoteKey( files[i].curRecord() ) );
+      }
     }
+    lt.build();
 
     // read all records
-    for ( uint64_t i = 0; i < size; i++ ) {
-      RemoteFile f = pq.top();
-      pq.pop();
+    for ( uint64_t i = 0; i < size and not lt.empty(); i++ ) {
+      RemoteFile & f = files[lt.top()];
       if ( !f.eof() ) {
         f.nextRecord();
-        pq.push( f );
+        lt.replace_top( RemoteKey( f.curRecord() ) );
+      } else {
+        lt.pop_top();
       }
     }
   }
 }
 
-static void writer( File out, Channel<vector<Record>> chn )
-{
-  static int pass = 0;
-  BufferedIO bio( out );
-  vector<Record> recs;
-  while ( true ) {
-    try {
-      cout << "wait write!" << endl;
-      recs = move( chn.recv() );
-      cout << "got write!" << endl;
-    } catch ( const std::exception & e ) {
-      print_exception( e );
-      break;
-    }
-    auto t0 = time_now();
-    for ( auto const & r : recs ) {
-      r.write( bio );
-    }
-    bio.flush( true );
-    out.fsync();
-    auto twrite = time_diff<ms>( t0 );
-    cout << "write, " << pass++ << ", " << twrite << endl;
-  }
-}
-
 static const size_t WRITE_BUF = 1048576; // 100MB * 2
 static const size_t WRITE_BUF_N = 2;
 
@@ -362,23 +470,23 @@ void Cluster::WriteAll( File out )
   if ( clients_.size() == 1 ) {
     // optimize for 1 node
     auto & c = clients_.front();
+    BlockWriter bout( out, WRITE_BUF * Rec::SIZE, WRITE_BUF_N );
     uint64_t size = Size();
     for ( uint64_t i = 0; i < size; i += chunkSize_ ) {
       c.sendRead( i, chunkSize_ );
       auto nrecs = c.recvRead();
       for ( uint64_t j = 0; j < nrecs; j++ ) {
         RecordPtr rec = c.readRecord();
-        rec.write( out );
+        memcpy( bout.next( Rec::SIZE ), rec.key(), Rec::SIZE );
       }
     }
+    bout.finish();
   } else {
     // general n node case
     vector<RemoteFile> files;
-    mystl::priority_queue_min<RemoteFile> pq{clients_.size()};
+    LoserTree<RemoteKey> lt{clients_.size()};
     uint64_t size = Size();
-
-    Channel<vector<Record>> chn( WRITE_BUF_N - 1 );
-    thread twriter( writer, move( out ), chn );
+    BlockWriter bout( out, WRITE_BUF * Rec::SIZE, WRITE_BUF_N );
 
     // prep -- size
     for ( auto & c : clients_ ) {
@@ -394,35 +502,30 @@ void Cluster::WriteAll( File out )
     }
 
     // prep -- 1st record
-    for ( auto & f : files ) {
-      f.nextRecord();
-      pq.push( f );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+      if ( files[i].eof() ) {
+        lt.close( i );
+      } else {
+        files[i].nextRecord();
+        lt.set( i, RemoteKey( files[i].curRecord() ) );
+      }
     }
+    lt.build();
 
     // read all records
-    vector<Record> recs;
-    recs.reserve( WRITE_BUF );
-    for ( uint64_t i = 0; i < size and pq.size() > 0; i++ ) {
-      RemoteFile f = pq.top();
-      pq.pop();
-      recs.emplace_back( f.curRecord() );
+    for ( uint64_t i = 0; i < size and not lt.empty(); i++ ) {
+      RemoteFile & f = files[lt.top()];
+      memcpy( bout.next( Rec::SIZE ), lt.top_key().rec.key(), Rec::SIZE );
       if ( !f.eof() ) {
         f.nextRecord();
-        pq.push( f );
-      }
-      if ( recs.size() >= WRITE_BUF ) {
-        chn.send( move( recs ) );
-        recs = vector<Record>();
+        lt.replace_top( RemoteKey( f.curRecord() ) );
+      } else {
+        lt.pop_top();
       }
     }
 
     // wait for write to finish
-    if ( recs.size() > 0 ) {
-      chn.send( move( recs ) );
-    }
-    chn.waitEmpty();
-    chn.close();
-    twriter.join();
+    bout.finish();
   }
 }
 
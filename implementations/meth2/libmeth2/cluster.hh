@@ -1,12 +1,14 @@
 #ifndef METH2_CLUSTER2_HH
 #define METH2_CLUSTER2_HH
 
+#include <string>
 #include <vector>
 
 #include "address.hh"
 #include "file.hh"
 
 #include "client.hh"
+#include "key_model.hh"
 
 /**
  * Strategy 2.
@@ -22,6 +24,7 @@ class Cluster
 {
 private:
   std::vector<Client> clients_;
+  std::vector<KeyModel> models_;
   uint64_t chunkSize_;
 
 public:
@@ -46,14 +49,16 @@ public:
   ~Cluster();
   uint64_t Size( void );
   std::vector<NodeSplit> GetSplit(uint64_t n);
+  std::vector<std::vector<NodeSplit>> GetSplits(std::vector<uint64_t> n);
   Record ReadFirst( void );
   void Read( uint64_t pos, uint64_t size );
+  std::vector<Record> ReadMany( const std::vector<uint64_t> & positions );
   void ReadAll( void );
   void WriteAll( File out );
 private:
   uint64_t Size( Client &c );
   std::vector<RecordLoc> IRead( Client &c, uint64_t pos, uint64_t size );
-  uint64_t IBSearch( Client &c, RecordLoc &rl);
+  static std::vector<RecordLoc> IRecords( const std::string &reply );
 };
 }
 
@@ -0,0 +1,175 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+
+#include "exception.hh"
+#include "file.hh"
+
+#include "index_file.hh"
+
+using namespace std;
+using namespace meth2;
+
+constexpr uint64_t IndexFile::MAGIC;
+constexpr uint32_t IndexFile::FORMAT;
+
+IndexFile::IndexFile( string path )
+  : path_{path}
+  , map_{nullptr}
+  , mapLen_{0}
+  , recs_{nullptr}
+  , count_{0}
+{}
+
+IndexFile::~IndexFile( void )
+{
+  if ( map_ != nullptr ) {
+    munmap( map_, mapLen_ );
+  }
+}
+
+/* FNV-1a style hash over 8 byte words (with any tail bytes zero padded). */
+uint64_t IndexFile::checksum( const char * buf, size_t len,
+                              uint64_t sum ) noexcept
+{
+  static constexpr uint64_t PRIME = 0x100000001b3ULL;
+  if ( sum == 0 ) {
+    sum = 0xcbf29ce484222325ULL;
+  }
+  size_t i = 0;
+  for ( ; i + sizeof( uint64_t ) <= len; i += sizeof( uint64_t ) ) {
+    uint64_t w;
+    memcpy( &w, buf + i, sizeof( w ) );
+    sum = ( sum ^ w ) * PRIME;
+  }
+  if ( i < len ) {
+    uint64_t w = 0;
+    memcpy( &w, buf + i, len - i );
+    sum = ( sum ^ w ) * PRIME;
+  }
+  return sum;
+}
+
+/* Records start on the first page boundary after the header + entries. */
+size_t IndexFile::data_offset( uint64_t files ) noexcept
+{
+  static constexpr size_t PAGE = 4096;
+  size_t hdr = sizeof( Header ) + files * sizeof( Entry );
+  return ( hdr + PAGE - 1 ) / PAGE * PAGE;
+}
+
+vector<IndexFile::Entry> IndexFile::entries( const vector<File> & data,
+                                             const vector<string> & files )
+{
+  vector<Entry> es;
+  for ( size_t i = 0; i < data.size(); i++ ) {
+    struct stat st;
+    SystemCall( "fstat", fstat( data[i].fd_num(), &st ) );
+    es.push_back( {uint64_t( st.st_size ), st.st_mtim.tv_sec,
+                   st.st_mtim.tv_nsec,
+                   checksum( files[i].c_str(), files[i].size() )} );
+  }
+  return es;
+}
+
+bool IndexFile::load( const vector<File> & data, const vector<string> & files )
+{
+  if ( access( path_.c_str(), R_OK ) != 0 ) {
+    return false;
+  }
+  File idx( path_, O_RDONLY );
+  size_t len = idx.size();
+
+  // header & entries
+  Header hdr;
+  if ( len < sizeof( hdr ) ) {
+    return false;
+  }
+  idx.read_all( (char *) &hdr, sizeof( hdr ) );
+  if ( hdr.magic != MAGIC or hdr.version != FORMAT
+       or hdr.recSize != sizeof( RecordIdx ) or hdr.files != data.size()
+       or len < data_offset( hdr.files ) + hdr.count * sizeof( RecordIdx ) ) {
+    return false;
+  }
+
+  vector<Entry> es( hdr.files );
+  idx.read_all( (char *) es.data(), es.size() * sizeof( Entry ) );
+
+  uint64_t sum = hdr.hdrSum;
+  hdr.hdrSum = 0;
+  uint64_t hsum = checksum( (const char *) &hdr, sizeof( hdr ) );
+  hsum = checksum( (const char *) es.data(), es.size() * sizeof( Entry ),
+                   hsum );
+  if ( sum != hsum ) {
+    return false;
+  }
+
+  // stale?
+  vector<Entry> cur = entries( data, files );
+  if ( memcmp( cur.data(), es.data(), es.size() * sizeof( Entry ) ) != 0 ) {
+    return false;
+  }
+
+  // map records
+  size_t off = data_offset( hdr.files );
+  size_t mlen = off + hdr.count * sizeof( RecordIdx );
+  void * m = mmap( nullptr, mlen, PROT_READ, MAP_SHARED, idx.fd_num(), 0 );
+  if ( m == MAP_FAILED ) {
+    throw unix_error( "mmap" );
+  }
+  map_ = (char *) m;
+  mapLen_ = mlen;
+  recs_ = (RecordIdx *) ( map_ + off );
+  count_ = hdr.count;
+
+  if ( Knobs::INDEX_VERIFY and
+       checksum( (const char *) recs_, count_ * sizeof( RecordIdx ) )
+         != hdr.dataSum ) {
+    munmap( map_, mapLen_ );
+    map_ = nullptr;
+    mapLen_ = 0;
+    recs_ = nullptr;
+    count_ = 0;
+    return false;
+  }
+
+  return true;
+}
+
+void IndexFile::save( const vector<File> & data, const vector<string> & files,
+                      const RecordIdx * recs, uint64_t count ) const
+{
+  vector<Entry> es = entries( data, files );
+
+  Header hdr;
+  memset( &hdr, 0, sizeof( hdr ) );
+  hdr.magic = MAGIC;
+  hdr.version = FORMAT;
+  hdr.recSize = sizeof( RecordIdx );
+  hdr.files = es.size();
+  hdr.count = count;
+  hdr.dataSum = checksum( (const char *) recs, count * sizeof( RecordIdx ) );
+  hdr.hdrSum = checksum( (const char *) &hdr, sizeof( hdr ) );
+  hdr.hdrSum = checksum( (const char *) es.data(), es.size() * sizeof( Entry ),
+                         hdr.hdrSum );
+
+  // write to a temporary and rename over, so a crash never leaves a
+  // half-written index that looks valid
+  string tmp = path_ + ".tmp";
+  {
+    File idx( tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+    idx.write_all( (const char *) &hdr, sizeof( hdr ) );
+    idx.write_all( (const char *) es.data(), es.size() * sizeof( Entry ) );
+    size_t off = sizeof( hdr ) + es.size() * sizeof( Entry );
+    string pad( data_offset( es.size() ) - off, '\0' );
+    idx.write_all( pad.data(), pad.size() );
+    idx.write_all( (const char *) recs, count * sizeof( RecordIdx ) );
+    idx.fsync();
+  }
+  SystemCall( "rename", rename( tmp.c_str(), path_.c_str() ) );
+}
@@ -0,0 +1,94 @@
+#ifndef METH2_INDEX_FILE_HH
+#define METH2_INDEX_FILE_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file.hh"
+
+#include "record.hh"
+
+namespace meth2
+{
+
+/**
+ * A persistent, sorted index of RecordIdx's for a set of data files.
+ *
+ * The file is a fixed header, one entry per data file (size, mtime and a hash
+ * of its path), and then the raw sorted records starting on a page boundary.
+ * We map the records straight from the file, so a warm start costs only
+ * validating the header against the data files. The header has its own
+ * checksum and is always checked; the record checksum is only verified when
+ * `Knobs::INDEX_VERIFY` is set, as doing so means reading the whole index.
+ */
+class IndexFile
+{
+public:
+  static constexpr uint64_t MAGIC = 0x5844495f3248544dULL; // "MTH2_IDX"
+  static constexpr uint32_t FORMAT = 2; // bump on any layout change
+
+private:
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t recSize;
+    uint64_t files;
+    uint64_t count;
+    uint64_t dataSum;
+    uint64_t hdrSum;
+  };
+
+  struct Entry
+  {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t path;
+  };
+
+  std::string path_;
+  char * map_;
+  size_t mapLen_;
+  RecordIdx * recs_;
+  uint64_t count_;
+
+  static std::vector<Entry> entries( const std::vector<File> & data,
+                                     const std::vector<std::string> & files );
+  static size_t data_offset( uint64_t files ) noexcept;
+
+public:
+  /* Hash of a buffer (continuing from `sum`, if given) */
+  static uint64_t checksum( const char * buf, size_t len,
+                            uint64_t sum = 0 ) noexcept;
+
+  IndexFile( std::string path );
+
+  /* No copy or move */
+  IndexFile( const IndexFile & ) = delete;
+  IndexFile & operator=( const IndexFile & ) = delete;
+  IndexFile( IndexFile && ) = delete;
+  IndexFile & operator=( IndexFile && ) = delete;
+
+  ~IndexFile( void );
+
+  /* Map the index if it exists and matches the data files. Returns false (and
+   * maps nothing) if it's missing, corrupt or stale. */
+  bool load( const std::vector<File> & data,
+             const std::vector<std::string> & files );
+
+  /* Write a sorted index for the data files (atomically replacing any
+   * existing index). */
+  void save( const std::vector<File> & data,
+             const std::vector<std::string> & files,
+             const RecordIdx * recs, uint64_t count ) const;
+
+  RecordIdx * data( void ) noexcept { return recs_; }
+  uint64_t size( void ) const noexcept { return count_; }
+  const std::string & path( void ) const noexcept { return path_; }
+};
+
+}
+
+#endif /* METH2_INDEX_FILE_HH */
@@ -0,0 +1,80 @@
+#include <algorithm>
+
+#include "key_model.hh"
+
+using namespace std;
+using namespace meth2;
+
+KeyModel::KeyModel( void )
+  : size_{0}
+  , err_{0}
+  , knots_{}
+{}
+
+KeyModel::KeyModel( const RecordIdx * recs, uint64_t n, size_t segments )
+  : size_{n}
+  , err_{0}
+  , knots_{}
+{
+  if ( n == 0 ) {
+    return;
+  }
+
+  segments = max<size_t>( 1, min<uint64_t>( segments, n ) );
+  for ( size_t j = 0; j < segments; j++ ) {
+    uint64_t r = n * j / segments;
+    knots_.push_back( {recs[r].prefix(), r} );
+  }
+  knots_.push_back( {recs[n - 1].prefix(), n - 1} );
+
+  for ( uint64_t i = 0; i < n; i++ ) {
+    uint64_t p = predict( recs[i].prefix() );
+    err_ = max( err_, p > i ? p - i : i - p );
+  }
+}
+
+uint64_t KeyModel::predict( uint64_t key ) const noexcept
+{
+  if ( knots_.size() == 0 or key <= knots_.front().key ) {
+    return 0;
+  } else if ( key >= knots_.back().key ) {
+    return knots_.back().rank;
+  }
+
+  // last knot with a key <= `key`
+  auto k = upper_bound( knots_.begin(), knots_.end(), key,
+    []( uint64_t a, const Knot & b ) { return a < b.key; } ) - 1;
+  auto k1 = k + 1;
+  if ( k1->key == k->key ) {
+    return k->rank;
+  }
+  return k->rank + uint64_t( (__uint128_t) ( key - k->key )
+                             * ( k1->rank - k->rank ) / ( k1->key - k->key ) );
+}
+
+pair<uint64_t, uint64_t> KeyModel::window( uint64_t key ) const noexcept
+{
+  uint64_t p = predict( key );
+  uint64_t lo = p > err_ + 1 ? p - err_ - 1 : 0;
+  uint64_t hi = min( size_, p + err_ + 2 );
+  return {lo, hi};
+}
+
+void KeyModel::write( IODevice & io ) const
+{
+  uint64_t hdr[3] = {size_, err_, knots_.size()};
+  io.write_all( reinterpret_cast<const char *>( hdr ), sizeof( hdr ) );
+  io.write_all( reinterpret_cast<const char *>( knots_.data() ),
+                knots_.size() * sizeof( Knot ) );
+}
+
+void KeyModel::read( IODevice & io )
+{
+  uint64_t hdr[3];
+  io.read_all( reinterpret_cast<char *>( hdr ), sizeof( hdr ) );
+  size_ = hdr[0];
+  err_ = hdr[1];
+  knots_.resize( hdr[2] );
+  io.read_all( reinterpret_cast<char *>( knots_.data() ),
+               knots_.size() * sizeof( Knot ) );
+}
@@ -0,0 +1,62 @@
+#ifndef METH2_KEY_MODEL_HH
+#define METH2_KEY_MODEL_HH
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "io_device.hh"
+
+#include "record.hh"
+
+namespace meth2
+{
+
+/**
+ * A piecewise-linear model from key prefix to rank over a node's sorted
+ * index.
+ *
+ * We keep a knot (key prefix, rank) every `n / segments` records and linearly
+ * interpolate between them, along with the largest error of the prediction
+ * over every record in the index. As the prediction is monotone in the key,
+ * the lower bound of any key lies within that error (+1) of its prediction, so
+ * a coordinator holding the model can fetch just that window of the index.
+ * For near uniform keys (e.g., gensort) the window is tiny.
+ */
+class KeyModel
+{
+private:
+  struct Knot
+  {
+    uint64_t key;
+    uint64_t rank;
+  };
+
+  uint64_t size_;
+  uint64_t err_;
+  std::vector<Knot> knots_;
+
+public:
+  KeyModel( void );
+
+  /* Build a model over the sorted records [recs, recs + n). */
+  KeyModel( const RecordIdx * recs, uint64_t n, size_t segments );
+
+  /* Predicted rank of a key (prefix). */
+  uint64_t predict( uint64_t key ) const noexcept;
+
+  /* Window [lo, hi) of ranks guaranteed to hold the lower bound of a key. */
+  std::pair<uint64_t, uint64_t> window( uint64_t key ) const noexcept;
+
+  uint64_t size( void ) const noexcept { return size_; }
+  uint64_t error( void ) const noexcept { return err_; }
+  size_t segments( void ) const noexcept { return knots_.size(); }
+
+  /* Serialization */
+  void write( IODevice & io ) const;
+  void read( IODevice & io );
+};
+
+}
+
+#endif /* METH2_KEY_MODEL_HH */
@@ -1,19 +1,26 @@
 #include <algorithm>
 #include <cassert>
+#include <future>
+#include <iterator>
+#include <memory>
 #include <system_error>
 #include <vector>
 #include <chrono>
 #include <utility>
 
 #include "address.hh"
+#include "async_io.hh"
 #include "buffered_io.hh"
 #include "exception.hh"
 #include "file.hh"
 #include "buffered_io.hh"
 #include "circular_io_rec.hh"
 #include "linux_compat.hh"
+#include "loser_tree.hh"
 #include "overlapped_rec_io.hh"
 #include "socket.hh"
+#include "string_io.hh"
+#include "threadpool.hh"
 #include "timestamp.hh"
 #include "util.hh"
 
@@ -21,22 +28,51 @@
 
 #include "meth1_merge.hh"
 #include "node.hh"
-#include "circular_aio.hh"
 
 using namespace std;
 using namespace meth2;
 
+/* The first data file, which names the index and sorted copy. Checked here as
+ * the init list needs it before the constructor body runs. */
+static const string & first_file( const vector<string> & files )
+{
+    if (files.empty()) {
+	throw runtime_error("No files to read from");
+    }
+    return files[0];
+}
+
 /* Construct Node */
 Node::Node( vector<string> files, string port )
   : data_{},
+  direct_{},
+  files_{},
+  index_{first_file(files) + ".idx"},
   recs_{},
+  model_{},
+  cache_{Knobs::VALUE_CACHE_BYTES, Knobs::VALUE_CACHE_SHARDS},
+  fetcher_{AsyncIO::ODIRECT ? direct_ : data_, &cache_},
   port_{port},
   last_{Rec::MIN},
   fpos_{0},
-  lpass_{0}
+  lpass_{0},
+  prefetch_{},
+  pfRecs_{},
+  pfPos_{0},
+  pfUsed_{0},
+  pfStale_{},
+  copy_{first_file(files) + ".sorted"},
+  copyReady_{false},
+  compact_{}
 {
+    if (files.size() > RecordIdx::FILE_MAX + 1) {
+	throw runtime_error("too many data files for RecordIdx");
+    }
     for (string &f : files) {
 	data_.emplace_back(f.c_str(), O_RDONLY);
+	if (AsyncIO::ODIRECT) {
+	    direct_.emplace_back(f.c_str(), O_RDONLY, File::DIRECT);
+	}
 	files_.push_back(f);
     }
 }
@@ -44,34 +80,166 @@ Node::Node( vector<string> files, string port )
 void Node::Initialize( void )
 {
     auto start = time_now();
-    // Load records
-    recs_.reserve(Size());
+
+    // Warm start from a persisted index?
+    if (Knobs::PERSIST_INDEX and index_.load(data_, files_)) {
+	recs_ = RawVector<RecordIdx>(index_.data(), index_.size(), false);
+	cout << "index: " << time_diff<ms>(start) << "mS" << endl;
+	start_compaction();
+	return;
+    }
+
+    // Load and sort records
+    vector<RecordIdx> recs = build_index();
+    start = time_now();
+
+    // Persist (best effort -- we can still serve without it)
+    if (Knobs::PERSIST_INDEX) {
+	try {
+	    index_.save(data_, files_, recs.data(), recs.size());
+	} catch (const exception & e) {
+	    print_exception(e);
+	}
+    }
+    recs_ = RawVector<RecordIdx>(move(recs));
+
+    auto saveTime = time_diff<ms>(start);
+
+    cout << "save: " << saveTime << "mS" << endl;
+
+    start_compaction();
+    return;
+}
+
+/* Build the sorted index: one loader per disk, each sorting fixed size runs
+ * (on a shared thread pool) as they fill, and then a parallel multiway merge
+ * of all the runs. */
+vector<RecordIdx> Node::build_index( void )
+{
+    auto t0 = time_now();
+    unique_ptr<RecordIdx[]> runs(new RecordIdx[Size()]);
+    ThreadPool tp;
+
+    // Load (all disks concurrently), sorting runs as they fill
+    vector<future<vector<IdxRun>>> loaders;
+    RecordIdx *dst = runs.get();
     for (size_t d = 0; d < data_.size(); d++) {
-	OverlappedRecordIO<Rec::SIZE> cio(data_[d]);
 	size_t nrecs = data_[d].size() / Rec::SIZE;
+	loaders.push_back(async(launch::async, [this, d, nrecs, dst, &tp]() {
+	    OverlappedRecordIO<Rec::SIZE> cio(data_[d]);
+	    vector<IdxRun> rs;
+	    vector<future<void>> sorts;
+
+	    cio.rewind();
+	    uint64_t rstart = 0;
+	    for (uint64_t i = 0; i < nrecs; i++) {
+		const uint8_t *rec = (const uint8_t *)cio.next_record();
+		dst[i] = RecordIdx(/*key*/rec, /*disk*/d, /*record*/i);
+		if (i + 1 - rstart == Knobs::INDEX_RUN or i + 1 == nrecs) {
+		    RecordIdx *f = dst + rstart, *l = dst + i + 1;
+		    sorts.push_back(tp.enqueue([f, l]() { rec_sort(f, l); }));
+		    rs.emplace_back(f, l);
+		    rstart = i + 1;
+		}
+	    }
+	    for (auto &s : sorts) {
+		s.get();
+	    }
+	    return rs;
+	}));
+	dst += nrecs;
+    }
 
-	cio.rewind();
-	for (uint64_t i = 0; i < nrecs; i++) {
-	    const uint8_t *rec = (const uint8_t *)cio.next_record();
-	    recs_.emplace_back(/*key*/rec,
-			       /*loc*/i * Rec::SIZE + Rec::KEY_LEN,
-			       /*host*/0,
-			       /*disk*/d);
-	}
+    vector<IdxRun> rs;
+    for (auto &l : loaders) {
+	vector<IdxRun> r = l.get();
+	rs.insert(rs.end(), r.begin(), r.end());
     }
 
-    auto loadTime = time_diff<ms>(start);
-    start = time_now();
+    auto loadTime = time_diff<ms>(t0);
+    t0 = time_now();
 
-    // Sort
-    rec_sort(recs_.begin(), recs_.end());
+    // Merge
+    vector<RecordIdx> recs(Size());
+    merge_runs(tp, rs, recs.data());
 
-    auto sortTime = time_diff<ms>(start);
+    auto mergeTime = time_diff<ms>(t0);
 
     cout << "load: " << loadTime << "mS" << endl;
-    cout << "sort: " << sortTime << "mS" << endl;
+    cout << "runs: " << rs.size() << endl;
+    cout << "merge: " << mergeTime << "mS" << endl;
 
-    return;
+    return recs;
+}
+
+/* Merge sorted runs into out, cutting the key space into one part per pool
+ * thread (at sampled splitters) and merging the parts in parallel. */
+void Node::merge_runs( ThreadPool & tp, const vector<IdxRun> & rs,
+                       RecordIdx * out )
+{
+    size_t nparts = rs.size() > 1 ? tp.concurrency() : 1;
+
+    // Sample splitters (RecordIdx's are unique, so cuts are exact)
+    vector<RecordIdx> samples;
+    for (auto &r : rs) {
+	size_t n = r.second - r.first;
+	for (size_t i = 1; i < nparts; i++) {
+	    if (n > 0) {
+		samples.push_back(r.first[n * i / nparts]);
+	    }
+	}
+    }
+    sort(samples.begin(), samples.end());
+
+    vector<RecordIdx> splits;
+    for (size_t i = 1; i < nparts and samples.size() > 0; i++) {
+	splits.push_back(samples[samples.size() * i / nparts]);
+    }
+    splits.push_back(RecordIdx(Rec::MAX));
+
+    // Cut each run at the splitters and merge the parts
+    vector<future<void>> parts;
+    vector<const RecordIdx *> lo;
+    for (auto &r : rs) {
+	lo.push_back(r.first);
+    }
+    for (size_t p = 0; p < splits.size(); p++) {
+	vector<IdxRun> part;
+	size_t n = 0;
+	for (size_t i = 0; i < rs.size(); i++) {
+	    const RecordIdx *hi = p + 1 == splits.size() ? rs[i].second
+		: lower_bound(lo[i], rs[i].second, splits[p]);
+	    part.emplace_back(lo[i], hi);
+	    n += hi - lo[i];
+	    lo[i] = hi;
+	}
+	parts.push_back(tp.enqueue([part, out]() {
+	    LoserTree<RecordIdx> lt{part.size()};
+	    vector<IdxRun> ins(part);
+	    for (size_t i = 0; i < ins.size(); i++) {
+		if (ins[i].first != ins[i].second) {
+		    lt.set(i, *ins[i].first++);
+		}
+	    }
+	    lt.build();
+
+	    RecordIdx *o = out;
+	    while (not lt.empty()) {
+		*o++ = lt.top_key();
+		IdxRun &r = ins[lt.top()];
+		if (r.first != r.second) {
+		    lt.replace_top(*r.first++);
+		} else {
+		    lt.pop_top();
+		}
+	    }
+	}));
+	out += n;
+    }
+
+    for (auto &p : parts) {
+	p.get();
+    }
 }
 
 /* Run the node - list and respond to RPCs */
@@ -80,6 +248,7 @@ void Node::Run( void )
   TCPSocket sock{IPV4};
   sock.set_reuseaddr();
   sock.set_nosigpipe();
+  sock.set_nodelay();
   sock.bind( {"0.0.0.0", port_} );
   sock.listen();
 
@@ -92,20 +261,7 @@ void Node::Run( void )
           cout << "Client EOF" << endl;
           break;
         }
-        switch ( str[0] ) {
-        case 0:
-          RPC_Read( client );
-          break;
-	case 1:
-          RPC_IRead( client );
-          break;
-        case 2:
-          RPC_Size( client );
-          break;
-        default:
-          throw runtime_error( "Unknown RPC method: " + to_string(str[0]) );
-          break;
-        }
+        Dispatch( str[0], client );
       }
     } catch ( const exception & e ) {
       cout << "Exception: " << e.what() << endl;
@@ -114,7 +270,65 @@ void Node::Run( void )
   }
 }
 
-void Node::RPC_Read( BufferedIO_O<TCPSocket> & client )
+void Node::Dispatch( int8_t rpc, BufferedIO & client )
+{
+  switch ( rpc ) {
+  case 0:
+    RPC_Read( client );
+    break;
+  case 1:
+    RPC_IRead( client );
+    break;
+  case 2:
+    RPC_Size( client );
+    break;
+  case 3:
+    RPC_Model( client );
+    break;
+  case 4:
+    RPC_Quantiles( client );
+    break;
+  case 5:
+    RPC_Count( client );
+    break;
+  case 6:
+    RPC_ReadMany( client );
+    break;
+  case 7:
+    RPC_Tagged( client );
+    break;
+  default:
+    throw runtime_error( "Unknown RPC method: " + to_string( rpc ) );
+    break;
+  }
+}
+
+/* A framed request -- (tag, length, request). We run the request against the
+ * buffered body, and reply with (tag, length, reply), so the coordinator can
+ * keep many requests in flight and match up the replies (see RpcQueue). */
+void Node::RPC_Tagged( BufferedIO & client )
+{
+  const char * str = client.read_buf_all( 2 * sizeof( uint64_t ) ).first;
+  uint64_t tag = *( reinterpret_cast<const uint64_t *>( str ) );
+  uint64_t len = *( reinterpret_cast<const uint64_t *>( str ) + 1 );
+
+  StringIO frame{client.read_all( len )};
+  {
+    BufferedIO body{frame, 4096, 64 * 1024};
+    int8_t rpc = body.read_buf_all( 1 ).first[0];
+    if ( rpc == 7 ) {
+      throw runtime_error( "Nested tagged RPC" );
+    }
+    Dispatch( rpc, body );
+  }
+
+  uint64_t hdr[2] = {tag, frame.output().size()};
+  client.write_all( reinterpret_cast<const char *>( hdr ), sizeof( hdr ) );
+  client.write_all( frame.output() );
+  client.flush( true );
+}
+
+void Node::RPC_Read( BufferedIO & client )
 {
   const char * str = client.read_buf_all( 2 * sizeof( uint64_t ) ).first;
   uint64_t pos = *( reinterpret_cast<const uint64_t *>( str ) );
@@ -137,7 +351,7 @@ void Node::RPC_Read( BufferedIO_O<TCPSocket> & client )
   client.flush( true );
 }
 
-void Node::RPC_IRead( BufferedIO_O<TCPSocket> & client )
+void Node::RPC_IRead( BufferedIO & client )
 {
   const char * str = client.read_buf_all( 2 * sizeof( uint64_t ) ).first;
   uint64_t pos = *( reinterpret_cast<const uint64_t *>( str ) );
@@ -151,12 +365,12 @@ void Node::RPC_IRead( BufferedIO_O<TCPSocket> & client )
 
   client.write_all( reinterpret_cast<const char *>( &amt ), sizeof( uint64_t ) );
   for (uint64_t i = 0; i < amt; i++) {
-    recs_[pos + i].write(client);
+    to_loc(recs_[pos + i]).write(client);
   }
   client.flush( true );
 }
 
-void Node::RPC_Size( BufferedIO_O<TCPSocket> & client )
+void Node::RPC_Size( BufferedIO & client )
 {
   uint64_t siz = Size();
   client.write_all( reinterpret_cast<const char *>( &siz ),
@@ -164,6 +378,86 @@ void Node::RPC_Size( BufferedIO_O<TCPSocket> & client )
   client.flush( true );
 }
 
+void Node::RPC_Model( BufferedIO & client )
+{
+  // built on first use, so a warm start needn't read the whole index
+  if ( model_.size() != recs_.size() ) {
+    auto t0 = time_now();
+    model_ = KeyModel( recs_.data(), recs_.size(), Knobs::MODEL_SEGMENTS );
+    cout << "model: " << time_diff<ms>( t0 ) << "mS, error "
+         << model_.error() << endl;
+  }
+  model_.write( client );
+  client.flush( true );
+}
+
+/* Reply with our size and `k` evenly spaced (rank, record) samples. */
+void Node::RPC_Quantiles( BufferedIO & client )
+{
+  const char * str = client.read_buf_all( sizeof( uint64_t ) ).first;
+  uint64_t k = *( reinterpret_cast<const uint64_t *>( str ) );
+  uint64_t siz = recs_.size();
+  k = min( k, siz );
+
+  client.write_all( reinterpret_cast<const char *>( &siz ), sizeof( uint64_t ) );
+  client.write_all( reinterpret_cast<const char *>( &k ), sizeof( uint64_t ) );
+  for ( uint64_t j = 0; j < k; j++ ) {
+    uint64_t r = siz * j / k;
+    client.write_all( reinterpret_cast<const char *>( &r ), sizeof( uint64_t ) );
+    to_loc( recs_[r] ).write( client );
+  }
+  client.flush( true );
+}
+
+/* Reply with the number of records below each of a batch of keys. */
+void Node::RPC_Count( BufferedIO & client )
+{
+  const char * str = client.read_buf_all( sizeof( uint64_t ) ).first;
+  uint64_t m = *( reinterpret_cast<const uint64_t *>( str ) );
+
+  vector<uint64_t> counts( m );
+  for ( uint64_t i = 0; i < m; i++ ) {
+    const uint8_t * key =
+      (const uint8_t *) client.read_buf_all( Rec::KEY_LEN ).first;
+    // smallest index entry with this key
+    RecordIdx k( key, 0, 0 );
+    counts[i] = lower_bound( recs_.begin(), recs_.end(), k ) - recs_.begin();
+  }
+
+  client.write_all( reinterpret_cast<const char *>( counts.data() ),
+                    m * sizeof( uint64_t ) );
+  client.flush( true );
+}
+
+/* Reply with the full records at each of a batch of positions, fetching all
+ * their values together. */
+void Node::RPC_ReadMany( BufferedIO & client )
+{
+  const char * str = client.read_buf_all( sizeof( uint64_t ) ).first;
+  uint64_t m = *( reinterpret_cast<const uint64_t *>( str ) );
+
+  vector<RecordIdx> idx( m );
+  for ( uint64_t i = 0; i < m; i++ ) {
+    str = client.read_buf_all( sizeof( uint64_t ) ).first;
+    uint64_t pos = *( reinterpret_cast<const uint64_t *>( str ) );
+    if ( pos >= recs_.size() ) {
+      throw runtime_error( "ReadMany position outside of range" );
+    }
+    idx[i] = recs_[pos];
+  }
+
+  auto t0 = time_now();
+  RecV recs;
+  fetcher_.fetch( idx.data(), m, recs );
+  print_cache( "read-many", m, t0 );
+
+  client.write_all( reinterpret_cast<const char *>( &m ), sizeof( uint64_t ) );
+  for ( auto const & r : recs ) {
+    r.write( client );
+  }
+  client.flush( true );
+}
+
 Node::RecV Node::Read( uint64_t pos, uint64_t size )
 {
   static size_t pass = 0;
@@ -171,17 +465,28 @@ Node::RecV Node::Read( uint64_t pos, uint64_t size )
   auto t0 = time_now();
   Node::RecV recs;
 
-  //if (size < 100) {
-  if (true) {
-    recs = linear_scan( pos , size );
-  } else {
-    if (pos + size > recs_.size()) {
-	size = recs_.size() - pos;
+  if ( copyReady_ ) {
+    // values are laid out in rank order, so just one sequential read
+    size = pos < recs_.size() ? min( size, recs_.size() - pos ) : 0;
+    drop_prefetch();
+    copy_.read( recs_.data(), pos, size, recs );
+  } else if ( Knobs::BATCH_FETCH ) {
+    size = pos < recs_.size() ? min( size, recs_.size() - pos ) : 0;
+    uint64_t have = take_prefetch( pos, size, recs );
+    if ( have == 0 ) {
+      fetcher_.fetch( recs_.data() + pos, size, recs );
+    } else if ( have < size ) {
+      RecV rest;
+      fetcher_.fetch( recs_.data() + pos + have, size - have, rest );
+      recs.insert( recs.end(), make_move_iterator( rest.begin() ),
+                   make_move_iterator( rest.end() ) );
     }
-    recs.reserve(size);
-    Circular_AIO caio(data_, recs_);
-    caio.begin(&recs, pos, size);
-    caio.wait();
+    // sequential reader? fetch its next chunks while we send this one
+    if ( Knobs::READ_PREFETCH and ( pos == fpos_ or pos == 0 ) ) {
+      start_prefetch( pos + size, size );
+    }
+  } else {
+    recs = linear_scan( pos , size );
   }
   if ( recs.size() > 0 ) {
     last_.copy( recs.back() );
@@ -189,10 +494,124 @@ Node::RecV Node::Read( uint64_t pos, uint64_t size )
   }
   //cout << "do-read, " << ++pass << ", " << time_diff<ms>( t0 ) << endl << 
   //endl;
+  print_cache( "read", recs.size(), t0 );
 
   return recs;
 }
 
+/* Print a read's timing and value cache hits, if it went through the cache */
+void Node::print_cache( const char * op, uint64_t n, clk::time_point t0 )
+{
+  auto hm = cache_.stats();
+  if ( hm.first + hm.second > 0 ) {
+    cout << op << ": " << n << " recs, " << time_diff<ms>( t0 )
+         << "mS, cache " << hm.first << " hits, " << hm.second << " misses"
+         << endl;
+  }
+}
+
+/* Use the background fetches for the start of a read, returning how many
+ * records they covered. A read shorter than a chunk leaves the rest of it for
+ * the next read, while a read elsewhere drops them all (without waiting). */
+uint64_t Node::take_prefetch( uint64_t pos, uint64_t size, RecV & recs )
+{
+  // reap abandoned fetches that have finished
+  pfStale_.erase( remove_if( pfStale_.begin(), pfStale_.end(),
+    []( const future<RecV> & f ) {
+      return f.wait_for( chrono::seconds( 0 ) ) == future_status::ready;
+    } ), pfStale_.end() );
+
+  uint64_t have = 0;
+  while ( have < size ) {
+    if ( pfUsed_ < pfRecs_.size() and pfPos_ == pos + have ) {
+      uint64_t n = min( size - have, pfRecs_.size() - pfUsed_ );
+      if ( recs.empty() and pfUsed_ == 0 and n == pfRecs_.size() ) {
+        recs = move( pfRecs_ );
+        pfRecs_.clear();
+      } else {
+        auto first = pfRecs_.begin() + pfUsed_;
+        recs.insert( recs.end(), make_move_iterator( first ),
+                     make_move_iterator( first + n ) );
+      }
+      pfPos_ += n;
+      pfUsed_ += n;
+      have += n;
+    } else if ( not prefetch_.empty()
+                and prefetch_.front().pos == pos + have ) {
+      pfRecs_ = prefetch_.front().recs.get();
+      pfPos_ = prefetch_.front().pos;
+      pfUsed_ = 0;
+      prefetch_.pop_front();
+    } else {
+      break;
+    }
+  }
+
+  if ( have == 0 ) {
+    drop_prefetch();
+  }
+  return have;
+}
+
+/* Abandon all background fetches, leaving any still running to be reaped
+ * later rather than waiting for them. */
+void Node::drop_prefetch( void )
+{
+  for ( auto & pf : prefetch_ ) {
+    pfStale_.push_back( move( pf.recs ) );
+  }
+  prefetch_.clear();
+  pfRecs_.clear();
+  pfUsed_ = 0;
+}
+
+/* Keep the chunks of `size` records following `pos` being fetched. */
+void Node::start_prefetch( uint64_t pos, uint64_t size )
+{
+  size = min( size, Knobs::READ_PREFETCH_MAX );
+  if ( not prefetch_.empty() ) {
+    pos = prefetch_.back().pos + prefetch_.back().len;
+  } else if ( pfUsed_ < pfRecs_.size() ) {
+    pos = pfPos_ + ( pfRecs_.size() - pfUsed_ );
+  }
+
+  while ( prefetch_.size() < Knobs::READ_PREFETCH_DEPTH and
+          pos < recs_.size() and size > 0 ) {
+    uint64_t n = min( size, recs_.size() - pos );
+    auto f = async( launch::async, [this, pos, n]() {
+      RecV recs;
+      fetcher_.fetch( recs_.data() + pos, n, recs );
+      return recs;
+    } );
+    prefetch_.push_back( {pos, n, move( f )} );
+    pos += n;
+  }
+}
+
+/* Rewrite our records in rank order (or find a copy already written from
+ * this index) in the background, switching reads over to it when done. We
+ * keep serving from the index and data files meanwhile. */
+void Node::start_compaction( void )
+{
+  if ( not Knobs::SORTED_COPY ) {
+    return;
+  }
+
+  compact_ = async( launch::async, [this]() {
+    try {
+      auto t0 = time_now();
+      if ( not copy_.load( recs_.data(), recs_.size() ) ) {
+        copy_.save( fetcher_, recs_.data(), recs_.size() );
+      }
+      copyReady_ = true;
+      cout << "compact: " << time_diff<ms>( t0 ) << "mS" << endl;
+    } catch ( const exception & e ) {
+      // best effort -- we can still serve without it
+      print_exception( e );
+    }
+  } );
+}
+
 uint64_t Node::Size( void )
 {
   uint64_t sz = 0;
@@ -210,6 +629,7 @@ Node::RecV Node::linear_scan(uint64_t start, uint64_t size )
   std::vector<RR> recV;
 
   recV.reserve(size);
+  bool cached = size <= Knobs::VALUE_CACHE_MAX_READ;
 
   //cout << "linear_scan, " << ++lpass_ << ", " << timestamp<ms>()
   //  << ", start" << endl;
@@ -217,16 +637,21 @@ Node::RecV Node::linear_scan(uint64_t start, uint64_t size )
   for ( uint64_t i = 0; i < size; i++ ) {
     size_t len;
     uint8_t buf[Rec::VAL_LEN];
-    RecordLoc &r = recs_[start + i];
 
     if (start + i >= recs_.size()) {
       break;
     }
 
-    len = data_[r.disk()].pread_all((char *)&buf, Rec::VAL_LEN, r.loc());
-    assert(len == Rec::VAL_LEN);
+    RecordLoc r = to_loc( recs_[start + i] );
+    if ( not cached or not cache_.get( r.disk(), r.loc(), buf ) ) {
+      len = data_[r.disk()].pread_all((char *)&buf, Rec::VAL_LEN, r.loc());
+      assert(len == Rec::VAL_LEN);
+      if ( cached ) {
+        cache_.put( r.disk(), r.loc(), buf );
+      }
+    }
 
-    recV.emplace_back(recs_[start+i], buf);
+    recV.emplace_back(r, buf);
   }
 
   auto tt = time_diff<ms>( t0 );
@@ -235,3 +660,9 @@ Node::RecV Node::linear_scan(uint64_t start, uint64_t size )
   return recV;
 }
 
+RecordLoc Node::to_loc( const RecordIdx & r )
+{
+  uint8_t key[Rec::KEY_LEN];
+  r.key( key );
+  return {key, r.rec() * Rec::SIZE + Rec::KEY_LEN, 0, uint32_t( r.file() )};
+}
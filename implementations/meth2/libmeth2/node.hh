@@ -1,15 +1,26 @@
 #ifndef METH2_NODE_HH
 #define METH2_NODE_HH
 
+#include <atomic>
+#include <deque>
+#include <future>
+
 #include "buffered_io.hh"
 #include "file.hh"
 #include "overlapped_rec_io.hh"
 #include "raw_vector.hh"
 #include "socket.hh"
+#include "threadpool.hh"
 #include "timestamp.hh"
 
 #include "record.hh"
 
+#include "index_file.hh"
+#include "key_model.hh"
+#include "sorted_copy.hh"
+#include "value_cache.hh"
+#include "value_fetcher.hh"
+
 /* Sorting strategy to use? Ordered slowest to fastest. */
 #define USE_PQ 0
 #define USE_CHUNK 1
@@ -46,14 +57,39 @@ public:
 
 private:
   std::vector<File> data_;
+  std::vector<File> direct_; // O_DIRECT, for the fetcher when AsyncIO needs it
   std::vector<std::string> files_;
-  std::vector<RecordLoc> recs_;
+  IndexFile index_;
+  RawVector<RecordIdx> recs_;
+  KeyModel model_;
+  ValueCache cache_;
+  ValueFetcher fetcher_;
   //OverlappedRecordIO<Rec::SIZE> recio_;
   std::string port_;
   Record last_;
   uint64_t fpos_;
   uint64_t lpass_;
 
+  /* READ_PREFETCH -- chunks after the last sequential read being fetched,
+   * the unread rest of the last chunk we took (from pfPos_), and abandoned
+   * fetches still running */
+  struct Prefetch
+  {
+    uint64_t pos;
+    uint64_t len;
+    std::future<RecV> recs;
+  };
+  std::deque<Prefetch> prefetch_;
+  RecV pfRecs_;
+  uint64_t pfPos_;
+  uint64_t pfUsed_;
+  std::vector<std::future<RecV>> pfStale_;
+
+  /* SORTED_COPY -- records rewritten in rank order, in the background */
+  SortedCopy copy_;
+  std::atomic<bool> copyReady_;
+  std::future<void> compact_;
+
 public:
   Node( std::vector<std::string> file, std::string port);
 
@@ -72,11 +108,33 @@ public:
   uint64_t Size( void );
 
 private:
+  using IdxRun = std::pair<const RecordIdx *, const RecordIdx *>;
+
+  std::vector<RecordIdx> build_index( void );
+  static void merge_runs( ThreadPool & tp, const std::vector<IdxRun> & rs,
+                          RecordIdx * out );
+
   RecV linear_scan( uint64_t pos , uint64_t size );
 
-  void RPC_Read( BufferedIO_O<TCPSocket> & client );
-  void RPC_IRead( BufferedIO_O<TCPSocket> & client );
-  void RPC_Size( BufferedIO_O<TCPSocket> & client );
+  void print_cache( const char * op, uint64_t n, clk::time_point t0 );
+  uint64_t take_prefetch( uint64_t pos, uint64_t size, RecV & recs );
+  void start_prefetch( uint64_t pos, uint64_t size );
+  void drop_prefetch( void );
+  void start_compaction( void );
+
+  /* Wire format of an index entry */
+  static RecordLoc to_loc( const RecordIdx & r );
+
+  void Dispatch( int8_t rpc, BufferedIO & client );
+
+  void RPC_Tagged( BufferedIO & client );
+  void RPC_Read( BufferedIO & client );
+  void RPC_IRead( BufferedIO & client );
+  void RPC_Size( BufferedIO & client );
+  void RPC_Model( BufferedIO & client );
+  void RPC_Quantiles( BufferedIO & client );
+  void RPC_Count( BufferedIO & client );
+  void RPC_ReadMany( BufferedIO & client );
 };
 }
 
@@ -62,6 +62,22 @@ public:
     return head_ > b.head_;
   }
 };
+
+/* Merge key for a RemoteFile's current record. We cache the key prefix, so
+ * most comparisons in the merge don't touch the receive buffers. */
+struct RemoteKey
+{
+  uint64_t pfx;
+  RecordPtr rec;
+
+  RemoteKey( void ) noexcept : pfx{0}, rec{(const char *) nullptr} {}
+  explicit RemoteKey( RecordPtr r ) noexcept : pfx{r.prefix()}, rec{r} {}
+
+  bool operator<( const RemoteKey & b ) const noexcept
+  {
+    return pfx != b.pfx ? pfx < b.pfx : rec < b.rec;
+  }
+};
 }
 
 #endif /* REMOTE_FILE_HH */
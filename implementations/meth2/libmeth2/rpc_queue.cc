@@ -0,0 +1,107 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tune_knobs.hh"
+
+#include "poller.hh"
+
+#include "client.hh"
+#include "rpc_queue.hh"
+
+using namespace std;
+using namespace meth2;
+using namespace PollerShortNames;
+
+RpcQueue::RpcQueue( vector<Client> & clients )
+  : clients_{clients}
+  , poller_{}
+  , inflight_( clients.size(), 0 )
+  , partial_( clients.size() )
+  , done_{}
+  , nextTag_{0}
+  , outstanding_{0}
+{
+  for ( size_t i = 0; i < clients_.size(); i++ ) {
+    poller_.add_action( Action( clients_[i].sock_.io(), Direction::In,
+      [this, i]() {
+        recv( i );
+        return ResultType::Continue;
+      },
+      [this, i]() { return inflight_[i] > 0; } ) );
+  }
+}
+
+uint64_t RpcQueue::post( size_t client, const string & req )
+{
+  while ( inflight_[client] >= Knobs::RPC_WINDOW ) {
+    poll();
+  }
+
+  uint64_t tag = nextTag_++;
+  clients_[client].sendTagged( tag, req );
+  inflight_[client]++;
+  outstanding_++;
+  return tag;
+}
+
+RpcQueue::Completion RpcQueue::next( void )
+{
+  while ( done_.empty() ) {
+    if ( outstanding_ == 0 ) {
+      throw runtime_error( "RpcQueue: no requests outstanding" );
+    }
+    poll();
+  }
+
+  Completion c = move( done_.front() );
+  done_.pop_front();
+  outstanding_--;
+  return c;
+}
+
+/* Make progress on at least one node's replies. */
+void RpcQueue::poll( void )
+{
+  // replies already pulled into a client's buffer won't wake the poller
+  for ( size_t i = 0; i < clients_.size(); i++ ) {
+    if ( inflight_[i] > 0 and clients_[i].sock_.buffered() > 0 ) {
+      recv( i );
+      return;
+    }
+  }
+
+  auto res = poller_.poll( -1 );
+  if ( res.result == Poller::Result::Type::Exit ) {
+    throw runtime_error( "RpcQueue: lost connection to node" );
+  }
+}
+
+/* Read what a node has sent, and cut any complete reply frames from it. */
+void RpcQueue::recv( size_t client )
+{
+  auto & sock = clients_[client].sock_;
+  auto data = sock.read_buf();
+  if ( data.second == 0 and sock.eof() ) {
+    throw runtime_error( "RpcQueue: node closed connection" );
+  }
+
+  string & buf = partial_[client];
+  buf.append( data.first, data.second );
+
+  constexpr size_t hdr = 2 * sizeof( uint64_t );
+  size_t off = 0;
+  while ( buf.size() - off >= hdr ) {
+    uint64_t tag, len;
+    memcpy( &tag, buf.data() + off, sizeof( uint64_t ) );
+    memcpy( &len, buf.data() + off + sizeof( uint64_t ), sizeof( uint64_t ) );
+    if ( buf.size() - off - hdr < len ) {
+      break;
+    }
+    done_.push_back( {client, tag, buf.substr( off + hdr, len )} );
+    inflight_[client]--;
+    off += hdr + len;
+  }
+  buf.erase( 0, off );
+}
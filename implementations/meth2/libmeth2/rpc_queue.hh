@@ -0,0 +1,71 @@
+#ifndef METH2_RPC_QUEUE_HH
+#define METH2_RPC_QUEUE_HH
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "poller.hh"
+
+#include "client.hh"
+
+namespace meth2
+{
+
+/**
+ * RpcQueue keeps many tagged requests in flight to a set of nodes, and hands
+ * back their replies as they arrive, from whichever node answers first.
+ *
+ * Each request is sent in a (tag, length) frame, and the node replies with a
+ * frame carrying the same tag, so replies can be read off every node's socket
+ * (driven by a Poller) without knowing which RPC they answer. Don't mix
+ * untagged RPCs on a client while it has tagged requests outstanding.
+ */
+class RpcQueue
+{
+public:
+  /* A finished request -- the node it went to, its tag and the raw reply,
+   * which can be decoded by wrapping it in a StringIO. */
+  struct Completion
+  {
+    size_t client;
+    uint64_t tag;
+    std::string reply;
+  };
+
+private:
+  std::vector<Client> & clients_;
+  Poller poller_;
+  std::vector<uint64_t> inflight_;
+  std::vector<std::string> partial_;
+  std::deque<Completion> done_;
+  uint64_t nextTag_;
+  uint64_t outstanding_;
+
+  void recv( size_t client );
+  void poll( void );
+
+public:
+  RpcQueue( std::vector<Client> & clients );
+
+  /* No copy or move (the poller refers to our state) */
+  RpcQueue( const RpcQueue & ) = delete;
+  RpcQueue & operator=( const RpcQueue & ) = delete;
+  RpcQueue( RpcQueue && ) = delete;
+  RpcQueue & operator=( RpcQueue && ) = delete;
+
+  /* Send a request message (e.g., `Client::msgIRead`) to a node, returning
+   * its tag. Blocks while the node has `Knobs::RPC_WINDOW` requests in
+   * flight. */
+  uint64_t post( size_t client, const std::string & req );
+
+  /* Wait for the next reply from any node */
+  Completion next( void );
+
+  /* Requests posted but not yet returned by `next` */
+  uint64_t outstanding( void ) const noexcept { return outstanding_; }
+};
+}
+
+#endif /* METH2_RPC_QUEUE_HH */
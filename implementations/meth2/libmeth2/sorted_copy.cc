@@ -0,0 +1,130 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "exception.hh"
+#include "file.hh"
+
+#include "tune_knobs.hh"
+
+#include "index_file.hh"
+#include "sorted_copy.hh"
+
+using namespace std;
+using namespace meth2;
+
+constexpr uint64_t SortedCopy::MAGIC;
+constexpr uint32_t SortedCopy::FORMAT;
+constexpr size_t SortedCopy::DATA_OFFSET;
+
+SortedCopy::SortedCopy( string path )
+  : path_{path}
+  , file_{}
+  , count_{0}
+{}
+
+bool SortedCopy::load( const RecordIdx * recs, uint64_t count )
+{
+  if ( access( path_.c_str(), R_OK ) != 0 ) {
+    return false;
+  }
+  unique_ptr<File> f( new File( path_, O_RDONLY ) );
+
+  Header hdr;
+  uint64_t fsize = f->size();
+  if ( fsize < sizeof( hdr ) ) {
+    return false;
+  }
+  f->read_all( (char *) &hdr, sizeof( hdr ) );
+
+  uint64_t sum = hdr.hdrSum;
+  hdr.hdrSum = 0;
+  if ( hdr.magic != MAGIC or hdr.version != FORMAT
+       or hdr.recSize != Rec::SIZE or hdr.count != count
+       or fsize < DATA_OFFSET + count * Rec::SIZE
+       or sum != IndexFile::checksum( (const char *) &hdr, sizeof( hdr ) ) ) {
+    return false;
+  }
+
+  // written from this index?
+  if ( hdr.indexSum !=
+       IndexFile::checksum( (const char *) recs, count * sizeof( RecordIdx ) ) ) {
+    return false;
+  }
+
+  file_ = move( f );
+  count_ = count;
+  return true;
+}
+
+void SortedCopy::save( ValueFetcher & fetcher, const RecordIdx * recs,
+                       uint64_t count )
+{
+  Header hdr;
+  memset( &hdr, 0, sizeof( hdr ) );
+  hdr.magic = MAGIC;
+  hdr.version = FORMAT;
+  hdr.recSize = Rec::SIZE;
+  hdr.count = count;
+  hdr.indexSum =
+    IndexFile::checksum( (const char *) recs, count * sizeof( RecordIdx ) );
+  hdr.hdrSum = IndexFile::checksum( (const char *) &hdr, sizeof( hdr ) );
+
+  // write to a temporary and rename over, so a crash never leaves a
+  // half-written copy that looks valid
+  string tmp = path_ + ".tmp";
+  {
+    File out( tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+    string page( DATA_OFFSET, '\0' );
+    memcpy( &page[0], &hdr, sizeof( hdr ) );
+    out.write_all( page );
+
+    // fetch values a chunk at a time, in index order
+    const uint64_t chunk = Knobs::SORTED_COPY_CHUNK;
+    unique_ptr<char[]> buf( new char[chunk * Rec::SIZE] );
+    vector<Record> vals;
+    for ( uint64_t i = 0; i < count; i += chunk ) {
+      uint64_t n = min( chunk, count - i );
+      fetcher.fetch( recs + i, n, vals );
+      char * b = buf.get();
+      for ( auto & r : vals ) {
+        memcpy( b, r.key(), Rec::KEY_LEN );
+        memcpy( b + Rec::KEY_LEN, r.val(), Rec::VAL_LEN );
+        b += Rec::SIZE;
+      }
+      out.write_all( buf.get(), n * Rec::SIZE );
+    }
+    out.fsync();
+  }
+  SystemCall( "rename", rename( tmp.c_str(), path_.c_str() ) );
+
+  file_.reset( new File( path_, O_RDONLY ) );
+  count_ = count;
+}
+
+void SortedCopy::read( const RecordIdx * recs, uint64_t pos, uint64_t n,
+                       vector<Record> & out )
+{
+  out.resize( n );
+  if ( n == 0 ) {
+    return;
+  }
+
+  unique_ptr<char[]> buf( new char[n * Rec::SIZE] );
+  size_t len = file_->pread_all( buf.get(), n * Rec::SIZE,
+                                 DATA_OFFSET + pos * Rec::SIZE );
+  if ( len != n * Rec::SIZE ) {
+    throw runtime_error( "short read of sorted copy" );
+  }
+
+  const uint8_t * r = (const uint8_t *) buf.get();
+  for ( uint64_t i = 0; i < n; i++, r += Rec::SIZE ) {
+    out[i].copy( r, recs[pos + i].rec() * Rec::SIZE + Rec::KEY_LEN );
+  }
+}
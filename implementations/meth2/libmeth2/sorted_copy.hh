@@ -0,0 +1,76 @@
+#ifndef METH2_SORTED_COPY_HH
+#define METH2_SORTED_COPY_HH
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file.hh"
+
+#include "record.hh"
+
+#include "value_fetcher.hh"
+
+namespace meth2
+{
+
+/**
+ * A copy of a node's records laid out in index (sorted) order, so a range of
+ * ranks is one sequential read rather than a random read per record.
+ *
+ * The file is a one page header (holding the record count and a checksum of
+ * the index it was written from) followed by the full records. A copy only
+ * loads if it was written from the same index, so it goes stale with it.
+ */
+class SortedCopy
+{
+public:
+  static constexpr uint64_t MAGIC = 0x54524f535f32484dULL; // "MH2_SORT"
+  static constexpr uint32_t FORMAT = 1; // bump on any layout change
+  static constexpr size_t DATA_OFFSET = 4096;
+
+private:
+  struct Header
+  {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t recSize;
+    uint64_t count;
+    uint64_t indexSum;
+    uint64_t hdrSum;
+  };
+
+  std::string path_;
+  std::unique_ptr<File> file_;
+  uint64_t count_;
+
+public:
+  SortedCopy( std::string path );
+
+  /* No copy or move */
+  SortedCopy( const SortedCopy & ) = delete;
+  SortedCopy & operator=( const SortedCopy & ) = delete;
+  SortedCopy( SortedCopy && ) = delete;
+  SortedCopy & operator=( SortedCopy && ) = delete;
+
+  /* Open the copy if it exists and was written from index `recs`. Returns
+   * false if it's missing, corrupt or stale. */
+  bool load( const RecordIdx * recs, uint64_t count );
+
+  /* Write the copy for index `recs` (fetching the values with `fetcher`,
+   * atomically replacing any existing copy) and open it. */
+  void save( ValueFetcher & fetcher, const RecordIdx * recs, uint64_t count );
+
+  /* Read ranks [pos, pos + n) into `out` (resized to n). `recs` is the index,
+   * for each record's original location. */
+  void read( const RecordIdx * recs, uint64_t pos, uint64_t n,
+             std::vector<Record> & out );
+
+  uint64_t size( void ) const noexcept { return count_; }
+  const std::string & path( void ) const noexcept { return path_; }
+};
+
+}
+
+#endif /* METH2_SORTED_COPY_HH */
@@ -0,0 +1,89 @@
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "record.hh"
+
+#include "value_cache.hh"
+
+using namespace std;
+using namespace meth2;
+
+ValueCache::ValueCache( uint64_t bytes, size_t shards )
+  : shards_( shards )
+  , slots_{uint32_t( bytes / ENTRY_BYTES / shards )}
+  , hits_{0}
+  , misses_{0}
+{
+  // value slots are allocated untouched, and the keys, reference bits and
+  // map grow with them, so memory is only used as we fill
+  for ( auto & s : shards_ ) {
+    s.vals.reset( new uint8_t[uint64_t( slots_ ) * Rec::VAL_LEN] );
+  }
+}
+
+ValueCache::Shard & ValueCache::shard( uint64_t k ) noexcept
+{
+  // offsets are multiples of the record size, so mix before picking
+  return shards_[( k * 0x9E3779B97F4A7C15ULL >> 32 ) % shards_.size()];
+}
+
+bool ValueCache::get( uint32_t disk, uint64_t off, uint8_t * val )
+{
+  uint64_t k = key( disk, off );
+  Shard & s = shard( k );
+  {
+    lock_guard<mutex> lg( s.lock );
+    auto it = s.map.find( k );
+    if ( it != s.map.end() ) {
+      s.ref[it->second] = true;
+      memcpy( val, s.vals.get() + uint64_t( it->second ) * Rec::VAL_LEN,
+              Rec::VAL_LEN );
+      hits_++;
+      return true;
+    }
+  }
+  misses_++;
+  return false;
+}
+
+void ValueCache::put( uint32_t disk, uint64_t off, const uint8_t * val )
+{
+  if ( slots_ == 0 ) {
+    return;
+  }
+
+  uint64_t k = key( disk, off );
+  Shard & s = shard( k );
+  lock_guard<mutex> lg( s.lock );
+  if ( s.map.count( k ) > 0 ) {
+    return;
+  }
+
+  uint32_t slot;
+  if ( s.used < slots_ ) {
+    slot = s.used++;
+    s.keys.push_back( k );
+    s.ref.push_back( false );
+  } else {
+    // CLOCK: give referenced slots a second chance
+    while ( s.ref[s.hand] ) {
+      s.ref[s.hand] = false;
+      s.hand = ( s.hand + 1 ) % slots_;
+    }
+    slot = s.hand;
+    s.hand = ( s.hand + 1 ) % slots_;
+    s.map.erase( s.keys[slot] );
+  }
+
+  s.keys[slot] = k;
+  s.ref[slot] = false;
+  s.map[k] = slot;
+  memcpy( s.vals.get() + uint64_t( slot ) * Rec::VAL_LEN, val, Rec::VAL_LEN );
+}
+
+pair<uint64_t, uint64_t> ValueCache::stats( void )
+{
+  return {hits_.exchange( 0 ), misses_.exchange( 0 )};
+}
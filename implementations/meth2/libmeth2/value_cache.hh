@@ -0,0 +1,85 @@
+#ifndef METH2_VALUE_CACHE_HH
+#define METH2_VALUE_CACHE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "record.hh"
+
+namespace meth2
+{
+
+/**
+ * A memory-bounded cache of record values, keyed by (disk, offset).
+ *
+ * The cache is split into shards (by a hash of the key), each with its own
+ * lock, a fixed array of value slots and a CLOCK hand for eviction: a hit
+ * sets the slot's reference bit, and the hand clears bits until it finds an
+ * unreferenced slot to replace.
+ */
+class ValueCache
+{
+private:
+  struct Shard
+  {
+    std::mutex lock;
+    std::unordered_map<uint64_t, uint32_t> map;
+    std::unique_ptr<uint8_t[]> vals;
+    std::vector<uint64_t> keys;
+    std::vector<bool> ref;
+    uint32_t used;
+    uint32_t hand;
+
+    Shard( void )
+      : lock{}, map{}, vals{}, keys{}, ref{}, used{0}, hand{0}
+    {}
+  };
+
+  /* Memory a cached value costs, at worst: the value; its key in `keys`
+   * (twice over, as the vector doubles); its map node (key and slot, next
+   * pointer and the allocator's header); and up to two bucket pointers (the
+   * bucket array doubles too). The reference bit is lost in the rounding. */
+  static constexpr uint64_t ENTRY_BYTES = Rec::VAL_LEN
+    + 2 * sizeof( uint64_t ) + sizeof( std::pair<const uint64_t, uint32_t> )
+    + 4 * sizeof( void * );
+
+  std::vector<Shard> shards_;
+  uint32_t slots_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+
+  static uint64_t key( uint32_t disk, uint64_t off ) noexcept
+  {
+    return ( uint64_t( disk ) << 56 ) | off;
+  }
+  Shard & shard( uint64_t k ) noexcept;
+
+public:
+  /* A cache using up to about `bytes` (values and bookkeeping) over `shards`
+   * shards */
+  ValueCache( uint64_t bytes, size_t shards );
+
+  /* No copy or move */
+  ValueCache( const ValueCache & ) = delete;
+  ValueCache & operator=( const ValueCache & ) = delete;
+  ValueCache( ValueCache && ) = delete;
+  ValueCache & operator=( ValueCache && ) = delete;
+
+  /* Copy the value at (disk, off) to `val` if cached */
+  bool get( uint32_t disk, uint64_t off, uint8_t * val );
+
+  /* Insert the value at (disk, off), evicting another if full */
+  void put( uint32_t disk, uint64_t off, const uint8_t * val );
+
+  /* Lookups that hit and missed since the last call */
+  std::pair<uint64_t, uint64_t> stats( void );
+};
+
+}
+
+#endif /* METH2_VALUE_CACHE_HH */
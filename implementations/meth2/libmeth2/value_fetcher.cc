@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+
+#include "async_io.hh"
+#include "file.hh"
+
+#include "record.hh"
+
+#include "value_fetcher.hh"
+
+#ifdef HAVE_TBB_TASK_GROUP_H
+#include "tbb/task_group.h"
+#endif
+
+using namespace std;
+using namespace meth2;
+
+ValueFetcher::ValueFetcher( vector<File> & io, ValueCache * cache )
+  : io_{io}
+  , cache_{cache}
+  , mtx_{}
+  , idle_{}
+{}
+
+/* Buffer space per read -- an O_DIRECT read must start and end on page
+ * boundaries, so may take up to a page either side of its values. */
+uint64_t ValueFetcher::slot_size( uint32_t disk ) const noexcept
+{
+  return io_[disk].is_odirect()
+    ? Knobs::FETCH_MAX_READ + 2 * Knobs::FETCH_PAGE : Knobs::FETCH_MAX_READ;
+}
+
+unique_ptr<ValueFetcher::Engine> ValueFetcher::take_engine( uint32_t disk )
+{
+  {
+    unique_lock<mutex> lck{mtx_};
+    // sized here, as our owner may still be opening `io_` when we're built
+    if ( idle_.size() < io_.size() ) {
+      idle_.resize( io_.size() );
+    }
+    if ( idle_[disk].size() > 0 ) {
+      unique_ptr<Engine> e = move( idle_[disk].back() );
+      idle_[disk].pop_back();
+      return e;
+    }
+  }
+
+  constexpr size_t depth = Knobs::FETCH_QUEUE_DEPTH;
+  char * bufp = nullptr;
+  if ( posix_memalign( (void **) &bufp, Knobs::FETCH_PAGE,
+                       depth * slot_size( disk ) ) != 0 ) {
+    throw bad_alloc();
+  }
+  unique_ptr<char, void (*)( void * )> bufs( bufp, free );
+  return unique_ptr<Engine>( new Engine{
+    unique_ptr<AsyncIO>( new AsyncIO( io_[disk].fd_num(), depth ) ),
+    move( bufs )} );
+}
+
+void ValueFetcher::give_engine( uint32_t disk, unique_ptr<Engine> e )
+{
+  unique_lock<mutex> lck{mtx_};
+  idle_[disk].push_back( move( e ) );
+}
+
+void ValueFetcher::fetch( const RecordIdx * recs, uint64_t n, RecV & out )
+{
+  out.resize( n );
+
+  // group the values we don't have cached by disk
+  bool cached = cache_ != nullptr and n <= Knobs::VALUE_CACHE_MAX_READ;
+  vector<vector<Value>> vals( io_.size() );
+  for ( uint64_t i = 0; i < n; i++ ) {
+    uint64_t loc = recs[i].rec() * Rec::SIZE + Rec::KEY_LEN;
+    if ( cached ) {
+      uint8_t key[Rec::KEY_LEN], val[Rec::VAL_LEN];
+      if ( cache_->get( recs[i].file(), loc, val ) ) {
+        recs[i].key( key );
+        out[i].copy( key, val, loc );
+        continue;
+      }
+    }
+    vals[recs[i].file()].push_back( {loc, i} );
+  }
+
+#ifdef HAVE_TBB_TASK_GROUP_H
+  tbb::task_group tg;
+  for ( size_t d = 0; d < io_.size(); d++ ) {
+    if ( vals[d].size() > 0 ) {
+      tg.run( [this, d, &vals, recs, &out, cached]() {
+        fetch_disk( d, vals[d], recs, out, cached );
+      } );
+    }
+  }
+  tg.wait();
+#else
+  for ( size_t d = 0; d < io_.size(); d++ ) {
+    if ( vals[d].size() > 0 ) {
+      fetch_disk( d, vals[d], recs, out, cached );
+    }
+  }
+#endif
+}
+
+void ValueFetcher::fetch_disk( uint32_t disk, vector<Value> & vals,
+                               const RecordIdx * recs, RecV & out,
+                               bool cached )
+{
+  File & io = io_[disk];
+  static constexpr uint64_t PAGE = Knobs::FETCH_PAGE;
+  static constexpr uint64_t MAX_READ = Knobs::FETCH_MAX_READ;
+
+  // sort by offset and coalesce values sharing a page with their neighbour
+  sort( vals.begin(), vals.end() );
+  vector<Read> reads;
+  for ( uint64_t i = 0; i < vals.size(); i++ ) {
+    uint64_t loc = vals[i].loc;
+    if ( reads.size() > 0 ) {
+      Read & r = reads.back();
+      uint64_t end = r.off + r.len;
+      if ( loc / PAGE <= ( end - 1 ) / PAGE
+           and loc + Rec::VAL_LEN - r.off <= MAX_READ ) {
+        r.len = max( end, loc + Rec::VAL_LEN ) - r.off;
+        r.last = i + 1;
+        continue;
+      }
+    }
+    reads.push_back( {loc, Rec::VAL_LEN, i, i + 1} );
+  }
+
+  // an O_DIRECT read must start and end on page boundaries (into a page
+  // aligned buffer), so may take up to a page either side of its values
+  const bool direct = io.is_odirect();
+  const uint64_t SLOT = slot_size( disk );
+  auto extent = [direct]( const Read & r ) -> pair<uint64_t, uint64_t> {
+    if ( not direct ) {
+      return {r.off, r.len};
+    }
+    uint64_t off = r.off / PAGE * PAGE;
+    return {off, ( r.off + r.len + PAGE - 1 ) / PAGE * PAGE - off};
+  };
+
+  // (an engine that fails mid-batch is dropped rather than reused)
+  unique_ptr<Engine> eng = take_engine( disk );
+  AsyncIO & aio = *eng->aio;
+  char * bufs = eng->bufs.get();
+  size_t depth = min<size_t>( aio.depth(), reads.size() );
+  vector<size_t> slot( reads.size() );
+  vector<size_t> free;
+  for ( size_t s = 0; s < depth; s++ ) {
+    free.push_back( s );
+  }
+
+  uint64_t next = 0;
+  for ( uint64_t done = 0; done < reads.size(); done++ ) {
+    // queue up as many reads as we have free slots, then submit together
+    for ( ; next < reads.size() and free.size() > 0; next++ ) {
+      slot[next] = free.back();
+      free.pop_back();
+      auto ext = extent( reads[next] );
+      aio.prepare( bufs + slot[next] * SLOT, ext.second, ext.first, next );
+    }
+
+    AsyncIO::completion c = aio.complete();
+    const Read & r = reads[c.first];
+    const char * buf = bufs + slot[c.first] * SLOT;
+    uint64_t start = extent( r ).first;
+
+    // an aligned read may run past the end of the file, so only need what
+    // covers the values
+    uint64_t need = r.off + r.len - start;
+    if ( c.second < need ) {
+      throw runtime_error( "short value read ( " + to_string( c.second ) +
+        " vs " + to_string( need ) + " )" );
+    }
+
+    // scatter into output in key order
+    for ( uint64_t i = r.first; i < r.last; i++ ) {
+      const Value & v = vals[i];
+      uint8_t key[Rec::KEY_LEN];
+      recs[v.idx].key( key );
+      const uint8_t * val = (const uint8_t *) buf + ( v.loc - start );
+      out[v.idx].copy( key, val, v.loc );
+      if ( cached ) {
+        cache_->put( disk, v.loc, val );
+      }
+    }
+    free.push_back( slot[c.first] );
+  }
+
+  give_engine( disk, move( eng ) );
+}
@@ -0,0 +1,90 @@
+#ifndef METH2_VALUE_FETCHER_HH
+#define METH2_VALUE_FETCHER_HH
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "async_io.hh"
+#include "file.hh"
+
+#include "record.hh"
+
+#include "value_cache.hh"
+
+namespace meth2
+{
+
+/**
+ * Fetch the values for a batch of (sorted) record locations.
+ *
+ * We group the locations by disk and sort each group by file offset, so each
+ * disk sees an ascending sweep rather than random seeks. Values that fall in
+ * the same page as their neighbour are coalesced into a single read. Each disk
+ * then keeps `Knobs::FETCH_QUEUE_DEPTH` reads in flight (see AsyncIO), and as
+ * reads complete we scatter the values back into the output in key order.
+ *
+ * Setting up an AsyncIO isn't free, so each disk keeps a pool of them (with
+ * their read buffers) for reuse, one for each thread fetching from it at once.
+ */
+class ValueFetcher
+{
+public:
+  using RecV = std::vector<Record>;
+
+private:
+  /* A value to fetch: its offset on disk and position in the batch. */
+  struct Value
+  {
+    uint64_t loc;
+    uint64_t idx;
+
+    bool operator<( const Value & b ) const noexcept { return loc < b.loc; }
+  };
+
+  /* A coalesced read covering values [first, last) of a disk's batch. */
+  struct Read
+  {
+    uint64_t off;
+    uint64_t len;
+    uint64_t first;
+    uint64_t last;
+  };
+
+  /* An AsyncIO for one disk, with a buffer slot for each read in flight. */
+  struct Engine
+  {
+    std::unique_ptr<AsyncIO> aio;
+    std::unique_ptr<char, void (*)( void * )> bufs;
+  };
+
+  std::vector<File> & io_;
+  ValueCache * cache_;
+  std::mutex mtx_;
+  std::vector<std::vector<std::unique_ptr<Engine>>> idle_;
+
+  uint64_t slot_size( uint32_t disk ) const noexcept;
+  std::unique_ptr<Engine> take_engine( uint32_t disk );
+  void give_engine( uint32_t disk, std::unique_ptr<Engine> e );
+
+  void fetch_disk( uint32_t disk, std::vector<Value> & vals,
+                   const RecordIdx * recs, RecV & out, bool cached );
+
+public:
+  /* Fetch from `io`, going through `cache` (if any) for small batches */
+  ValueFetcher( std::vector<File> & io, ValueCache * cache = nullptr );
+
+  /* No copy or move */
+  ValueFetcher( const ValueFetcher & ) = delete;
+  ValueFetcher & operator=( const ValueFetcher & ) = delete;
+  ValueFetcher( ValueFetcher && ) = delete;
+  ValueFetcher & operator=( ValueFetcher && ) = delete;
+
+  /* Fetch records [recs, recs + n) into `out` (resized to n). */
+  void fetch( const RecordIdx * recs, uint64_t n, RecV & out );
+};
+
+}
+
+#endif /* METH2_VALUE_FETCHER_HH */
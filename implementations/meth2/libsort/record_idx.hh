@@ -0,0 +1,99 @@
+#ifndef RECORD_IDX_HH
+#define RECORD_IDX_HH
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "record_common.hh"
+
+/**
+ * A 16 byte (key, location) tuple for sorting without touching values.
+ *
+ * We hold the big-endian 8 byte key prefix, and pack the 2 byte key tail,
+ * the file number and the record number within that file into a second word.
+ * Comparing the two words as integers orders on key and then location, so
+ * RecordIdx always has a total order, regardless of WITHLOC.
+ */
+class RecordIdx
+{
+public:
+  static constexpr size_t FILE_BITS = 8;
+  static constexpr size_t REC_BITS = 40;
+  static constexpr uint64_t FILE_MAX = ( uint64_t( 1 ) << FILE_BITS ) - 1;
+  static constexpr uint64_t REC_MAX = ( uint64_t( 1 ) << REC_BITS ) - 1;
+
+private:
+  uint64_t pfx_;
+  uint64_t loc_; // tail (16) | file (8) | rec (40)
+
+public:
+  RecordIdx( void ) noexcept : pfx_{0}, loc_{0} {}
+
+  RecordIdx( const uint8_t * k, uint64_t file, uint64_t rec ) noexcept
+    : pfx_{Rec::key_prefix( k )}
+    , loc_{ uint64_t( Rec::key_tail( k ) ) << ( FILE_BITS + REC_BITS )
+            | file << REC_BITS | rec }
+  {}
+
+  explicit RecordIdx( Rec::limit_t lim ) noexcept
+    : pfx_{lim == Rec::MAX ? UINT64_MAX : 0}
+    , loc_{lim == Rec::MAX ? UINT64_MAX : 0}
+  {}
+
+  /* Accessors */
+  uint64_t prefix( void ) const noexcept { return pfx_; }
+  uint16_t tail( void ) const noexcept
+  {
+    return loc_ >> ( FILE_BITS + REC_BITS );
+  }
+  uint64_t file( void ) const noexcept
+  {
+    return ( loc_ >> REC_BITS ) & FILE_MAX;
+  }
+  uint64_t rec( void ) const noexcept { return loc_ & REC_MAX; }
+
+  /* Reconstruct the 10 byte key into `out`. */
+  void key( uint8_t * out ) const noexcept
+  {
+    for ( size_t i = 0; i < Rec::KEY_LEN; i++ ) {
+      out[i] = ( *this )[i];
+    }
+  }
+
+  /* methods for boost::sort & radix_sort */
+  unsigned char operator[]( size_t i ) const noexcept
+  {
+    return i < sizeof( pfx_ ) ? pfx_ >> ( 56 - 8 * i )
+                              : loc_ >> ( 56 - 8 * ( i - sizeof( pfx_ ) ) );
+  }
+  size_t size( void ) const noexcept { return Rec::KEY_LEN; }
+
+  /* comparison */
+  comp_op( <, RecordIdx )
+  comp_op( <=, RecordIdx )
+  comp_op( >, RecordIdx )
+  comp_op( >=, RecordIdx )
+  comp_op( ==, RecordIdx )
+  comp_op( !=, RecordIdx )
+
+  int compare( const RecordIdx & b ) const noexcept
+  {
+    if ( pfx_ != b.pfx_ ) {
+      return pfx_ < b.pfx_ ? -1 : 1;
+    }
+    if ( loc_ != b.loc_ ) {
+      return loc_ < b.loc_ ? -1 : 1;
+    }
+    return 0;
+  }
+};
+
+static_assert( sizeof( RecordIdx ) == 16, "RecordIdx is 16 bytes" );
+
+inline void iter_swap( RecordIdx * a, RecordIdx * b ) noexcept
+{
+  std::swap( *a, *b );
+}
+
+#endif /* RECORD_IDX_HH */
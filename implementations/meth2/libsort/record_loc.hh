@@ -15,11 +15,22 @@
 class RecordLoc
 {
 public:
+#if WITHPREFIX == 1
+  uint64_t pfx_ = 0;
+#endif
   uint64_t loc_;  // File Offset
   uint32_t host_; // Host
   uint32_t disk_; // Disk
   uint8_t key_[Rec::KEY_LEN];
 
+  void set_key( const uint8_t * k ) noexcept
+  {
+    memcpy( key_, k, Rec::KEY_LEN );
+#if WITHPREFIX == 1
+    pfx_ = Rec::key_prefix( key_ );
+#endif
+  }
+
   RecordLoc( void ) noexcept : loc_{0}, host_{0}, disk_{0} {}
 
   RecordLoc( const uint8_t * s, uint64_t loc = 0,
@@ -28,7 +39,7 @@ public:
       host_{host},
       disk_{disk}
   {
-    memcpy( key_, s, Rec::KEY_LEN );
+    set_key( s );
   }
 
   RecordLoc( const RecordLoc & other )
@@ -36,7 +47,7 @@ public:
       host_{other.host_},
       disk_{other.disk_}
   {
-    memcpy( key_, other.key(), Rec::KEY_LEN );
+    set_key( other.key() );
   }
 
   RecordLoc & operator=( const RecordLoc & other )
@@ -45,7 +56,7 @@ public:
       loc_ = other.loc();
       host_ = other.host();
       disk_ = other.disk();
-      memcpy( key_, other.key(), Rec::KEY_LEN );
+      set_key( other.key() );
     }
     return *this;
   }
@@ -57,9 +68,14 @@ public:
     loc_ = loc;
     host_ = host;
     disk_ = disk;
-    memcpy( key_, s, Rec::KEY_LEN );
+    set_key( s );
   }
   const uint8_t * key( void ) const noexcept { return key_; }
+#if WITHPREFIX == 1
+  uint64_t prefix( void ) const noexcept { return pfx_; }
+#else
+  uint64_t prefix( void ) const noexcept { return Rec::key_prefix( key_ ); }
+#endif
   uint64_t loc( void ) const noexcept { return loc_; }
   uint32_t host( void ) const noexcept { return host_; }
   uint32_t disk( void ) const noexcept { return disk_; }
@@ -89,6 +105,9 @@ public:
   void read( IODevice &io )
   {
       io.read_all((char *)key_, Rec::KEY_LEN);
+#if WITHPREFIX == 1
+      pfx_ = Rec::key_prefix( key_ );
+#endif
       io.read_all( reinterpret_cast<char *>( &loc_ ),
                    sizeof( uint64_t ) );
       io.read_all( reinterpret_cast<char *>( &host_ ),
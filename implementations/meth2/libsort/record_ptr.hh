@@ -55,6 +55,7 @@ public:
   const uint8_t * data( void ) const noexcept { return r_; }
   const uint8_t * key( void ) const noexcept { return r_; }
   const uint8_t * val( void ) const noexcept { return r_ + Rec::KEY_LEN; }
+  uint64_t prefix( void ) const noexcept { return Rec::key_prefix( r_ ); }
 #if WITHLOC == 1
   uint64_t loc( void ) const noexcept { return loc_; }
 #else
@@ -145,6 +145,7 @@ public:
   /* Accessors */
   const uint8_t * key( void ) const noexcept { return key_; }
   const uint8_t * val( void ) const noexcept { return val_; }
+  uint64_t prefix( void ) const noexcept { return Rec::key_prefix( key_ ); }
 #if WITHLOC == 1
   uint64_t loc( void ) const noexcept { return loc_; }
 #else
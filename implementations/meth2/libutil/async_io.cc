@@ -0,0 +1,307 @@
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+
+#include "async_io.hh"
+#include "exception.hh"
+
+using namespace std;
+
+#if defined(HAVE_LIBURING_H)
+
+AsyncIO::AsyncIO( int fd, size_t depth )
+  : fd_{fd}
+  , depth_{depth}
+  , inflight_{0}
+  , queued_{0}
+  , ring_{}
+{
+  int r = io_uring_queue_init( depth_, &ring_, 0 );
+  if ( r < 0 ) {
+    throw unix_error( "io_uring_queue_init", -r );
+  }
+}
+
+AsyncIO::~AsyncIO( void )
+{
+  try {
+    while ( inflight() > 0 ) {
+      complete();
+    }
+  } catch ( const exception & e ) {
+    print_exception( e );
+  }
+  io_uring_queue_exit( &ring_ );
+}
+
+void AsyncIO::prepare( char * buf, size_t nbytes, off_t offset, uint64_t tag )
+{
+  // check before taking an SQE, so we never leave one half prepared
+  if ( inflight() >= depth_ ) {
+    throw runtime_error( "too many reads in flight" );
+  }
+  struct io_uring_sqe * sqe = io_uring_get_sqe( &ring_ );
+  if ( sqe == nullptr ) {
+    throw runtime_error( "io_uring submission queue full" );
+  }
+  io_uring_prep_read( sqe, fd_, buf, nbytes, offset );
+  io_uring_sqe_set_data( sqe, (void *) tag );
+  queued_++;
+}
+
+void AsyncIO::submit( void )
+{
+  // io_uring_submit may take only some of the SQEs (the rest stay queued in
+  // the ring for the next call), so loop until all are in
+  while ( queued_ > 0 ) {
+    int r = io_uring_submit( &ring_ );
+    if ( r < 0 ) {
+      throw unix_error( "io_uring_submit", -r );
+    }
+    inflight_ += r;
+    queued_ -= r;
+  }
+}
+
+AsyncIO::completion AsyncIO::complete( void )
+{
+  submit();
+  struct io_uring_cqe * cqe;
+  int r = io_uring_wait_cqe( &ring_, &cqe );
+  if ( r < 0 ) {
+    throw unix_error( "io_uring_wait_cqe", -r );
+  }
+  uint64_t tag = cqe->user_data;
+  int res = cqe->res;
+  io_uring_cqe_seen( &ring_, cqe );
+  inflight_--;
+  if ( res < 0 ) {
+    throw unix_error( "io_uring read", -res );
+  }
+  return {tag, size_t( res )};
+}
+
+const char * AsyncIO::backend( void ) { return "io_uring"; }
+
+#elif defined(HAVE_LINUX_AIO_ABI_H)
+
+static inline int io_setup( unsigned nr, aio_context_t * ctxp )
+{
+  return syscall( __NR_io_setup, nr, ctxp );
+}
+
+static inline int io_destroy( aio_context_t ctx )
+{
+  return syscall( __NR_io_destroy, ctx );
+}
+
+static inline int io_submit( aio_context_t ctx, long nr, struct iocb ** iocbpp )
+{
+  return syscall( __NR_io_submit, ctx, nr, iocbpp );
+}
+
+static inline int io_getevents( aio_context_t ctx, long min_nr, long max_nr,
+                                struct io_event * events,
+                                struct timespec * timeout )
+{
+  return syscall( __NR_io_getevents, ctx, min_nr, max_nr, events, timeout );
+}
+
+AsyncIO::AsyncIO( int fd, size_t depth )
+  : fd_{fd}
+  , depth_{depth}
+  , inflight_{0}
+  , queued_{0}
+  , ctx_{0}
+  , cbs_{new struct iocb[depth]}
+  , free_{}
+  , pending_{new struct iocb *[depth]}
+{
+  SystemCall( "io_setup", io_setup( depth_, &ctx_ ) );
+  for ( size_t i = 0; i < depth_; i++ ) {
+    free_.push_back( &cbs_[i] );
+  }
+}
+
+AsyncIO::~AsyncIO( void )
+{
+  try {
+    while ( inflight() > 0 ) {
+      complete();
+    }
+  } catch ( const exception & e ) {
+    print_exception( e );
+  }
+  io_destroy( ctx_ );
+}
+
+void AsyncIO::prepare( char * buf, size_t nbytes, off_t offset, uint64_t tag )
+{
+  if ( free_.empty() ) {
+    throw runtime_error( "too many reads in flight" );
+  }
+  struct iocb * cb = free_.front();
+  memset( cb, 0, sizeof( *cb ) );
+  cb->aio_data = tag;
+  cb->aio_fildes = fd_;
+  cb->aio_lio_opcode = IOCB_CMD_PREAD;
+  cb->aio_buf = (uint64_t) buf;
+  cb->aio_nbytes = nbytes;
+  cb->aio_offset = offset;
+
+  free_.pop_front();
+  pending_[queued_++] = cb;
+}
+
+void AsyncIO::submit( void )
+{
+  // io_submit may take only some of the iocbs, so loop until all are in
+  size_t done = 0;
+  while ( done < queued_ ) {
+    done += SystemCall( "io_submit",
+                        io_submit( ctx_, queued_ - done, &pending_[done] ) );
+  }
+  inflight_ += queued_;
+  queued_ = 0;
+}
+
+AsyncIO::completion AsyncIO::complete( void )
+{
+  submit();
+  struct io_event ev;
+  while ( SystemCall( "io_getevents",
+                      io_getevents( ctx_, 1, 1, &ev, nullptr ) ) == 0 ) {}
+  free_.push_back( (struct iocb *) ev.obj );
+  inflight_--;
+  if ( ev.res < 0 ) {
+    throw unix_error( "aio read", -ev.res );
+  }
+  return {ev.data, ev.res};
+}
+
+const char * AsyncIO::backend( void ) { return "aio"; }
+
+#else
+
+constexpr size_t AsyncIO::MAX_THREADS;
+
+AsyncIO::AsyncIO( int fd, size_t depth )
+  : fd_{fd}
+  , depth_{depth}
+  , inflight_{0}
+  , queued_{0}
+  , pending_{}
+  , todo_{}
+  , done_{}
+  , mtx_{}
+  , todo_cv_{}
+  , done_cv_{}
+  , stop_{false}
+  , workers_{}
+{
+  size_t n = max<size_t>( min( depth_, MAX_THREADS ), 1 );
+  for ( size_t i = 0; i < n; i++ ) {
+    workers_.emplace_back( &AsyncIO::worker, this );
+  }
+}
+
+AsyncIO::~AsyncIO( void )
+{
+  try {
+    while ( inflight() > 0 ) {
+      complete();
+    }
+  } catch ( const exception & e ) {
+    print_exception( e );
+  }
+  {
+    unique_lock<mutex> lck( mtx_ );
+    stop_ = true;
+  }
+  todo_cv_.notify_all();
+  for ( auto & w : workers_ ) {
+    w.join();
+  }
+}
+
+void AsyncIO::worker( void )
+{
+  while ( true ) {
+    request r{nullptr, 0, 0, 0};
+    {
+      unique_lock<mutex> lck( mtx_ );
+      todo_cv_.wait( lck, [this] { return stop_ or not todo_.empty(); } );
+      if ( stop_ ) {
+        return;
+      }
+      r = todo_.front();
+      todo_.pop_front();
+    }
+
+    result res{{r.tag, 0}, nullptr};
+    try {
+      res.c.second = SystemCall( "pread",
+        ::pread( fd_, r.buf, r.nbytes, r.offset ) );
+    } catch ( ... ) {
+      res.err = current_exception();
+    }
+
+    {
+      unique_lock<mutex> lck( mtx_ );
+      done_.push_back( res );
+    }
+    done_cv_.notify_one();
+  }
+}
+
+void AsyncIO::prepare( char * buf, size_t nbytes, off_t offset, uint64_t tag )
+{
+  if ( inflight() >= depth_ ) {
+    throw runtime_error( "too many reads in flight" );
+  }
+  pending_.push_back( {buf, nbytes, offset, tag} );
+  queued_++;
+}
+
+void AsyncIO::submit( void )
+{
+  if ( queued_ == 0 ) {
+    return;
+  }
+  {
+    unique_lock<mutex> lck( mtx_ );
+    todo_.insert( todo_.end(), pending_.begin(), pending_.end() );
+  }
+  todo_cv_.notify_all();
+  pending_.clear();
+  inflight_ += queued_;
+  queued_ = 0;
+}
+
+AsyncIO::completion AsyncIO::complete( void )
+{
+  submit();
+  if ( inflight_ == 0 ) {
+    throw runtime_error( "no reads in flight" );
+  }
+
+  result res{{0, 0}, nullptr};
+  {
+    unique_lock<mutex> lck( mtx_ );
+    done_cv_.wait( lck, [this] { return not done_.empty(); } );
+    res = done_.front();
+    done_.pop_front();
+  }
+  inflight_--;
+  if ( res.err ) {
+    rethrow_exception( res.err );
+  }
+  return res.c;
+}
+
+const char * AsyncIO::backend( void ) { return "pread-threads"; }
+
+#endif
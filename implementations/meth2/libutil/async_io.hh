@@ -0,0 +1,127 @@
+#ifndef ASYNC_IO_HH
+#define ASYNC_IO_HH
+
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+
+#if defined(HAVE_LIBURING_H)
+#include <liburing.h>
+#elif defined(HAVE_LINUX_AIO_ABI_H)
+#include <linux/aio_abi.h>
+#endif
+
+/**
+ * Keeps up to `depth` reads in flight against a file descriptor. Uses io_uring
+ * (through liburing) when available, otherwise Linux AIO (`io_submit`), and
+ * failing both, falls back to a pool of threads doing blocking `pread`s.
+ *
+ * Linux AIO is only asynchronous for O_DIRECT files -- on a cached file
+ * `io_submit` does each read before returning -- so callers should read
+ * through an O_DIRECT descriptor (with aligned reads) when `ODIRECT` is set.
+ *
+ * Reads may complete out of order, so each carries a caller chosen tag. Reads
+ * can be queued with `prepare` and then handed to the kernel together with a
+ * single `submit`, which matters when issuing many small random reads.
+ */
+class AsyncIO
+{
+public:
+  /* tag + bytes read */
+  using completion = std::pair<uint64_t, size_t>;
+
+#if !defined(HAVE_LIBURING_H) && defined(HAVE_LINUX_AIO_ABI_H)
+  static constexpr bool ODIRECT = true;
+#else
+  static constexpr bool ODIRECT = false;
+#endif
+
+  /* most threads the pread fallback will use */
+  static constexpr size_t MAX_THREADS = 16;
+
+private:
+  int fd_;
+  size_t depth_;
+  size_t inflight_;
+  size_t queued_;
+
+#if defined(HAVE_LIBURING_H)
+  struct io_uring ring_;
+#elif defined(HAVE_LINUX_AIO_ABI_H)
+  aio_context_t ctx_;
+  std::unique_ptr<struct iocb[]> cbs_;
+  std::deque<struct iocb *> free_;
+  std::unique_ptr<struct iocb *[]> pending_;
+#else
+  struct request
+  {
+    char * buf;
+    size_t nbytes;
+    off_t offset;
+    uint64_t tag;
+  };
+
+  struct result
+  {
+    completion c;
+    std::exception_ptr err;
+  };
+
+  std::vector<request> pending_;
+  std::deque<request> todo_;
+  std::deque<result> done_;
+  std::mutex mtx_;
+  std::condition_variable todo_cv_;
+  std::condition_variable done_cv_;
+  bool stop_;
+  std::vector<std::thread> workers_;
+
+  void worker( void );
+#endif
+
+public:
+  AsyncIO( int fd, size_t depth );
+
+  /* no copy or move */
+  AsyncIO( const AsyncIO & ) = delete;
+  AsyncIO & operator=( const AsyncIO & ) = delete;
+  AsyncIO( AsyncIO && ) = delete;
+  AsyncIO & operator=( AsyncIO && ) = delete;
+
+  ~AsyncIO( void );
+
+  /* Queue a read of `nbytes` at `offset` into `buf` (at most `depth` may be
+   * queued or in flight). */
+  void prepare( char * buf, size_t nbytes, off_t offset, uint64_t tag );
+
+  /* Submit all queued reads. */
+  void submit( void );
+
+  /* Queue and submit a single read. */
+  void submit( char * buf, size_t nbytes, off_t offset, uint64_t tag )
+  {
+    prepare( buf, nbytes, offset, tag );
+    submit();
+  }
+
+  /* Wait for the next read to complete (submitting any queued reads). */
+  completion complete( void );
+
+  size_t depth( void ) const noexcept { return depth_; }
+  size_t inflight( void ) const noexcept { return inflight_ + queued_; }
+
+  /* Name of the backend in use. */
+  static const char * backend( void );
+};
+
+#endif /* ASYNC_IO_HH */
@@ -0,0 +1,134 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+#include "block_writer.hh"
+#include "exception.hh"
+
+using namespace std;
+
+BlockWriter::BlockWriter( File & file, size_t bsize, size_t blocks )
+  : file_{file}
+  , flags_{0}
+  , odirect_{false}
+  , bsize_{bsize}
+  , nblocks_{max( blocks, size_t( 2 ) )}
+  , blocks_{new char *[nblocks_]}
+  , full_{nblocks_}
+  , free_{nblocks_}
+  , writer_{}
+  , cur_{nullptr}
+  , used_{0}
+  , off_{0}
+  , size_{0}
+  , finished_{false}
+{
+  if ( bsize_ == 0 or bsize_ % ALIGN != 0 ) {
+    throw runtime_error( "block size must be a multiple of "
+                         + to_string( ALIGN ) );
+  }
+
+  for ( size_t i = 0; i < nblocks_; i++ ) {
+    void * p;
+    if ( posix_memalign( &p, ALIGN, bsize_ ) != 0 ) {
+      throw runtime_error( "couldn't allocate aligned block" );
+    }
+    blocks_[i] = (char *) p;
+    if ( i > 0 ) {
+      free_.send( {blocks_[i], 0, 0} );
+    }
+  }
+  cur_ = blocks_[0];
+
+  // not all file systems support O_DIRECT, so fall back to cached IO
+  flags_ = SystemCall( "fcntl", fcntl( file_.fd_num(), F_GETFL ) );
+  odirect_ = ( flags_ & O_DIRECT ) or
+    fcntl( file_.fd_num(), F_SETFL, flags_ | O_DIRECT ) == 0;
+
+  writer_ = thread( &BlockWriter::write_loop, this );
+}
+
+BlockWriter::~BlockWriter( void )
+{
+  try {
+    finish();
+  } catch ( const exception & e ) {
+    print_exception( e );
+  }
+  for ( size_t i = 0; i < nblocks_; i++ ) {
+    free( blocks_[i] );
+  }
+}
+
+void BlockWriter::write_loop( void )
+{
+  while ( true ) {
+    block_t blk = full_.recv();
+    if ( blk.buf == nullptr ) {
+      break;
+    }
+    file_.pwrite_all( blk.buf, blk.len, blk.off );
+    free_.send( {blk.buf, 0, 0} );
+  }
+}
+
+void BlockWriter::submit( void )
+{
+  full_.send( {cur_, used_, off_} );
+  off_ += used_;
+  size_ += used_;
+  cur_ = free_.recv().buf;
+  used_ = 0;
+}
+
+void BlockWriter::seek( off_t offset )
+{
+  if ( offset % ALIGN != 0 or used_ % ALIGN != 0 ) {
+    throw runtime_error( "seek must stay aligned to " + to_string( ALIGN ) );
+  }
+  if ( used_ > 0 ) {
+    submit();
+  }
+  off_ = offset;
+}
+
+void BlockWriter::write( const char * buf, size_t n )
+{
+  while ( n > 0 ) {
+    auto b = buffer();
+    size_t m = min( n, b.second );
+    memcpy( b.first, buf, m );
+    commit( m );
+    buf += m;
+    n -= m;
+  }
+}
+
+void BlockWriter::finish( void )
+{
+  if ( finished_ ) {
+    return;
+  }
+  finished_ = true;
+
+  // pad the final block to alignment for O_DIRECT
+  off_t fsize = off_ + used_;
+  size_t pad = ( ALIGN - used_ % ALIGN ) % ALIGN;
+  if ( used_ > 0 ) {
+    memset( cur_ + used_, 0, pad );
+    full_.send( {cur_, used_ + pad, off_} );
+  }
+  full_.send( {nullptr, 0, 0} );
+  writer_.join();
+
+  if ( pad > 0 ) {
+    file_.truncate( fsize );
+  }
+  if ( odirect_ and not ( flags_ & O_DIRECT ) ) {
+    SystemCall( "fcntl", fcntl( file_.fd_num(), F_SETFL, flags_ ) );
+  }
+  file_.fsync();
+}
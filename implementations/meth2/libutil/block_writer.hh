@@ -0,0 +1,104 @@
+#ifndef BLOCK_WRITER_HH
+#define BLOCK_WRITER_HH
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "channel.hh"
+#include "file.hh"
+
+/**
+ * Writes a file through a small ring of aligned blocks, with a dedicated
+ * writer thread so that filling one block overlaps with writing another.
+ *
+ * Callers fill blocks in-place (no intermediate buffers), and we try to write
+ * them with O_DIRECT, falling back to cached IO if the file system doesn't
+ * support it. The final partial block is padded to alignment and the file
+ * truncated back to size, and we fsync just once, in `finish`.
+ *
+ * The file is written from offset 0, or from wherever we last `seek`ed to.
+ */
+class BlockWriter
+{
+public:
+  static constexpr size_t ALIGN = 4096;
+
+private:
+  struct block_t
+  {
+    char * buf;
+    size_t len;
+    off_t off;
+  };
+
+  File & file_;
+  int flags_;
+  bool odirect_;
+  size_t bsize_;
+  size_t nblocks_;
+  std::unique_ptr<char *[]> blocks_;
+  Channel<block_t> full_;
+  Channel<block_t> free_;
+  std::thread writer_;
+  char * cur_;
+  size_t used_;
+  off_t off_;
+  uint64_t size_;
+  bool finished_;
+
+  void write_loop( void );
+  void submit( void );
+
+public:
+  /* `bsize` must be a multiple of ALIGN. */
+  BlockWriter( File & file, size_t bsize, size_t blocks = 2 );
+
+  /* no copy or move */
+  BlockWriter( const BlockWriter & ) = delete;
+  BlockWriter & operator=( const BlockWriter & ) = delete;
+  BlockWriter( BlockWriter && ) = delete;
+  BlockWriter & operator=( BlockWriter && ) = delete;
+
+  ~BlockWriter( void );
+
+  /* Space for the next `n` bytes. The block size should be a multiple of `n`
+   * (e.g., a record size) so that a write never has to straddle blocks. */
+  char * next( size_t n )
+  {
+    if ( used_ + n > bsize_ ) {
+      submit();
+    }
+    char * p = cur_ + used_;
+    used_ += n;
+    return p;
+  }
+
+  /* The free space left in the current block, to fill and then `commit`. */
+  std::pair<char *, size_t> buffer( void )
+  {
+    if ( used_ == bsize_ ) {
+      submit();
+    }
+    return {cur_ + used_, bsize_ - used_};
+  }
+  void commit( size_t n ) noexcept { used_ += n; }
+
+  /* Copy `n` bytes (may straddle blocks). */
+  void write( const char * buf, size_t n );
+
+  /* Continue writing at `offset`. Both it and the amount written since the
+   * last seek must be multiples of ALIGN. */
+  void seek( off_t offset );
+
+  /* Write the final block, wait for the writer, truncate and fsync. */
+  void finish( void );
+
+  bool odirect( void ) const noexcept { return odirect_; }
+  uint64_t size( void ) const noexcept { return size_ + used_; }
+};
+
+#endif /* BLOCK_WRITER_HH */
@@ -93,6 +93,9 @@ public:
   /* using O_DIRECT? never, since using a buffer */
   bool is_odirect( void ) const noexcept override { return false; }
 
+  /* bytes read from the device but not yet consumed */
+  size_t buffered( void ) const noexcept { return rend_ - rstart_; }
+
   /* buffer read method */
   std::pair<const char *, size_t> read_buf( size_t limit = 0 );
   std::pair<const char *, size_t> read_buf_all( size_t nbytes );
@@ -2,6 +2,7 @@
 #define CIRCULAR_IO_HH
 
 #include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <system_error>
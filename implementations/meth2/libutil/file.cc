@@ -42,6 +42,12 @@ void File::fsync( void )
   SystemCall( "fsync", ::fsync( fd_num() ) );
 }
 
+/* truncate (or extend) file to given size */
+void File::truncate( off_t size )
+{
+  SystemCall( "ftruncate", ::ftruncate( fd_num(), size ) );
+}
+
 /* file size */
 off_t File::size( void ) const
 {
@@ -0,0 +1,125 @@
+#ifndef LOSER_TREE_HH
+#define LOSER_TREE_HH
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * Tournament (loser) tree for k-way merging.
+ *
+ * Each internal node holds the input that lost the match played there, with
+ * the overall winner kept at the root. Replacing the winner's key replays
+ * just the path from its leaf to the root, so we do one comparison per level
+ * rather than the two sifts of a heap pop + push. Keys are stored by value in
+ * a contiguous array (one slot per input), so callers should use a small key
+ * (e.g., a cached key prefix + pointer).
+ *
+ * Usage: `set` (or `close`) every input, `build`, and then repeatedly take
+ * `top` and either `replace_top` with the input's next key or `pop_top` once
+ * the input is exhausted. Ties are broken on input number, so the merge is
+ * stable.
+ */
+template <typename K, typename Less = std::less<K>>
+class LoserTree
+{
+private:
+  size_t k_;
+  std::vector<uint32_t> tree_; // [0] = winner, [1..k) = losers
+  std::vector<K> keys_;
+  std::vector<uint8_t> done_;
+  Less less_;
+
+  /* Does input a beat input b? Exhausted inputs lose to everything. */
+  bool beats( uint32_t a, uint32_t b ) const
+  {
+    if ( done_[a] or done_[b] ) {
+      return done_[b] and ( not done_[a] or a < b );
+    }
+    if ( less_( keys_[a], keys_[b] ) ) {
+      return true;
+    } else if ( less_( keys_[b], keys_[a] ) ) {
+      return false;
+    }
+    return a < b;
+  }
+
+  /* Play input `w` from its leaf up to the root. */
+  void replay( uint32_t w )
+  {
+    for ( size_t n = ( w + k_ ) / 2; n > 0; n /= 2 ) {
+      if ( beats( tree_[n], w ) ) {
+        std::swap( tree_[n], w );
+      }
+    }
+    tree_[0] = w;
+  }
+
+public:
+  explicit LoserTree( size_t k, Less less = Less() )
+    : k_{k}
+    , tree_( k > 0 ? k : 1, 0 )
+    , keys_( k )
+    , done_( k, 1 )
+    , less_{less}
+  {}
+
+  size_t size( void ) const noexcept { return k_; }
+
+  /* Set the first key of input `i` (before `build`). */
+  void set( size_t i, const K & key )
+  {
+    keys_[i] = key;
+    done_[i] = 0;
+  }
+
+  /* Mark input `i` as empty (before `build`). */
+  void close( size_t i ) { done_[i] = 1; }
+
+  /* Play the initial tournament. */
+  void build( void )
+  {
+    if ( k_ == 0 ) {
+      return;
+    }
+    std::vector<uint32_t> win( 2 * k_ );
+    for ( size_t i = 0; i < k_; i++ ) {
+      win[k_ + i] = i;
+    }
+    for ( size_t n = k_ - 1; n > 0; n-- ) {
+      uint32_t a = win[2 * n], b = win[2 * n + 1];
+      if ( beats( a, b ) ) {
+        win[n] = a;
+        tree_[n] = b;
+      } else {
+        win[n] = b;
+        tree_[n] = a;
+      }
+    }
+    tree_[0] = k_ == 1 ? 0 : win[1];
+  }
+
+  /* Have all inputs been exhausted? */
+  bool empty( void ) const noexcept { return k_ == 0 or done_[tree_[0]]; }
+
+  /* Input with the smallest key, and that key. */
+  size_t top( void ) const noexcept { return tree_[0]; }
+  const K & top_key( void ) const noexcept { return keys_[tree_[0]]; }
+
+  /* Replace the key of the winning input with its next key. */
+  void replace_top( const K & key )
+  {
+    keys_[tree_[0]] = key;
+    replay( tree_[0] );
+  }
+
+  /* The winning input is exhausted. */
+  void pop_top( void )
+  {
+    done_[tree_[0]] = 1;
+    replay( tree_[0] );
+  }
+};
+
+#endif /* LOSER_TREE_HH */
@@ -17,6 +17,7 @@
 #include "tbb/parallel_invoke.h"
 #endif
 
+#include "loser_tree.hh"
 #include "raw_vector.hh"
 
 // Granularity to switch to sequential merge at?
@@ -119,31 +120,25 @@ template <class T>
 size_t
 merge_move_n( RawVector<T> * in, size_t n, T * rs, T * re )
 {
-  size_t nout = 0;
-  size_t * pos = new size_t[n];
+  auto less = []( const T * a, const T * b ) { return *a < *b; };
+  LoserTree<const T *, decltype( less )> lt( n, less );
+  std::vector<size_t> pos( n, 0 );
+
   for ( size_t i = 0; i < n; i++ ) {
-    pos[i] = 0;
-  }
-  
-  while ( rs != re ) {
-    T * min = nullptr;
-    size_t which_i = 0;
-    
-    for ( size_t i = 0; i < n; i++ ) {
-      if ( pos[i] < in[i].size() ) {
-        if ( min == nullptr or *min > in[i][pos[i]] ) {
-          min = &in[i][pos[i]];
-          which_i = i;
-        }
-      }
+    if ( in[i].size() > 0 ) {
+      lt.set( i, &in[i][0] );
     }
+  }
+  lt.build();
 
-    if ( min != nullptr ) {
-      *rs++ = std::move( *min );
-      pos[which_i]++;
-      nout++;
+  size_t nout = 0;
+  for ( ; rs != re and not lt.empty(); nout++ ) {
+    size_t i = lt.top();
+    *rs++ = std::move( in[i][pos[i]] );
+    if ( ++pos[i] < in[i].size() ) {
+      lt.replace_top( &in[i][pos[i]] );
     } else {
-      break;
+      lt.pop_top();
     }
   }
 
@@ -0,0 +1,67 @@
+#ifndef STRING_IO_HH
+#define STRING_IO_HH
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "io_device.hh"
+
+/* An in-memory IODevice -- reads consume the string it was constructed with,
+ * and writes append to a second string. Used to handle or decode a framed
+ * message with code written against a socket. */
+class StringIO : public IODevice
+{
+private:
+  std::string in_;
+  size_t pos_;
+  std::string out_;
+
+protected:
+  /* io device state */
+  bool get_eof( void ) const noexcept override { return pos_ == in_.size(); }
+  void set_eof( void ) noexcept override { pos_ = in_.size(); }
+  void reset_eof( void ) noexcept override {}
+
+public:
+  explicit StringIO( std::string in = "" )
+    : in_{std::move( in )}
+    , pos_{0}
+    , out_{}
+  {}
+
+  /* accessors */
+  std::string & output( void ) noexcept { return out_; }
+
+  bool is_odirect( void ) const noexcept override { return false; }
+
+  size_t read( char * buf, size_t limit ) override
+  {
+    register_read();
+    limit = std::min( limit, in_.size() - pos_ );
+    memcpy( buf, in_.data() + pos_, limit );
+    pos_ += limit;
+    return limit;
+  }
+
+  size_t write( const char * buf, size_t nbytes ) override
+  {
+    register_write();
+    out_.append( buf, nbytes );
+    return nbytes;
+  }
+
+  size_t pread( char *, size_t, off_t ) override
+  {
+    throw std::runtime_error( "StringIO: pread not supported" );
+  }
+
+  size_t pwrite( const char *, size_t, off_t ) override
+  {
+    throw std::runtime_error( "StringIO: pwrite not supported" );
+  }
+};
+
+#endif /* STRING_IO_HH */
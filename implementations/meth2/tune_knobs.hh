@@ -16,6 +16,60 @@ namespace Knobs {
   static constexpr uint64_t IO_BLOCK = 4096 * 256 * 10; // 10MB
   static constexpr uint64_t DISK_BLOCKS = 400;          // 4GB
 
+  /* Index build: records per run sorted while the disks are still loading
+   * (the runs are then merged in parallel). */
+  static constexpr std::size_t INDEX_RUN = 1 << 22; // 64MB of RecordIdx
+
+  /* Sample keys each node sends the coordinator when it computes splits. */
+  static constexpr uint64_t SPLIT_SAMPLES = 1024;
+
+  /* Segments in the piecewise-linear key -> rank model each node serves to
+   * the coordinator (16 bytes each). */
+  static constexpr std::size_t MODEL_SEGMENTS = 4096;
+
+  /* Tagged RPCs the coordinator keeps in flight per node (see RpcQueue) --
+   * bounded so a node never blocks writing replies we aren't yet reading. */
+  static constexpr uint64_t RPC_WINDOW = 64;
+
+  /* Persist the sorted index next to the data (`<first file>.idx`), and map
+   * it on restart if it still matches the data files? Verifying the record
+   * checksum on restart means reading the whole index. */
+  static constexpr bool PERSIST_INDEX = true;
+  static constexpr bool INDEX_VERIFY = false;
+
+  /* Fetch a batch of values with ValueFetcher (offset sorted, coalesced and
+   * asynchronous) rather than a pread per record? */
+  static constexpr bool BATCH_FETCH = true;
+
+  /* Value fetch: reads kept in flight per disk, the page size within which
+   * neighbouring values are coalesced into one read, and the largest such
+   * read. With Linux AIO the reads are O_DIRECT and page aligned, so the page
+   * must be a multiple of the disk's block size. */
+  static constexpr std::size_t FETCH_QUEUE_DEPTH = 128;
+  static constexpr std::size_t FETCH_PAGE = 4096;
+  static constexpr std::size_t FETCH_MAX_READ = 64 * 1024;
+
+  /* Node value cache (CLOCK eviction, see ValueCache): memory for values and
+   * their bookkeeping, lock shards, and the largest read (in records) that goes through the cache --
+   * bigger reads are scans, which would only churn it. */
+  static constexpr uint64_t VALUE_CACHE_BYTES = 256 * 1024 * 1024;
+  static constexpr std::size_t VALUE_CACHE_SHARDS = 16;
+  static constexpr uint64_t VALUE_CACHE_MAX_READ = 4096;
+
+  /* When a client reads ranks sequentially, have the node fetch the values
+   * for its next READ_PREFETCH_DEPTH chunks in the background (concurrently)?
+   * Each chunk fetched ahead is capped at READ_PREFETCH_MAX records. */
+  static constexpr bool READ_PREFETCH = true;
+  static constexpr std::size_t READ_PREFETCH_DEPTH = 2;
+  static constexpr uint64_t READ_PREFETCH_MAX = 1024 * 1024; // 100MB
+
+  /* After loading, have each node rewrite its records in rank order to a
+   * second file (`<first data file>.sorted`) in the background, then serve
+   * reads from it sequentially? Costs a second copy of the data on disk. The
+   * rewrite fetches SORTED_COPY_CHUNK records at a time. */
+  static constexpr bool SORTED_COPY = false;
+  static constexpr uint64_t SORTED_COPY_CHUNK = 256 * 1024; // 25MB
+
   /* Buffered (not overlapped) IO size */
   static constexpr uint64_t IO_BUFFER_DEFAULT = 1024 * 1024;
 
@@ -51,8 +105,14 @@ namespace Knobs {
   /* Use parallel sort? */
   static constexpr bool PARALLEL_SORT = true;
 
-  /* Use hand-rolled memcmp? */
-  static constexpr bool USE_OWN_MEMCMP = false;
+  /* Use our in-place MSD radix sort rather than a comparison sort? Takes
+   * precedence over PARALLEL_SORT (the radix sort is itself parallel). */
+  static constexpr bool RADIX_SORT = true;
+
+  /* How to compare keys: libc memcmp, a hand-rolled byte loop, or as a
+   * big-endian 8 byte prefix + 2 byte tail integer compare? */
+  enum memcmp_t { LIBC_MEMCMP, BYTE_MEMCMP, INT_MEMCMP };
+  static constexpr memcmp_t USE_OWN_MEMCMP = INT_MEMCMP;
 
   /* Record -- use packed data structure? */
   #define PACKED 1
@@ -64,6 +124,11 @@ namespace Knobs {
    * duplicate keys aren't common, it's generally fine to not include location
    * information. */
   #define WITHLOC 0
+
+  /* RecordS & RecordLoc -- cache the big-endian 8 byte key prefix? Saves
+   * reloading and byte-swapping the key on every comparison (only useful with
+   * INT_MEMCMP), at the cost of 8 bytes per record. */
+  #define WITHPREFIX 0
 }
 
 #endif /* TUNE_KNOBS_HH */